@@ -3,309 +3,2722 @@
 // Pseudo Assembly generation (--asm),
 // Grammar tools: FIRST/FOLLOW, Left Recursion Elimination, Left Factoring (--demo-grammar)
 //
-// Build: g++ -std=c++17 main.cpp -O2 -o my_compiler
-// TAC:   ./my_compiler < program.src
+// Build: g++ -std=c++17 main.cpp -O2 -pthread -o my_compiler   (-mavx2 for 32-byte lexer scans,
+//        -DMINI_NO_SIMD for the scalar fallback)
+// TAC:   ./my_compiler < program.src      (or: ./my_compiler program.src, mmap'd)
 // ASM:   ./my_compiler --asm < program.src
+//        --regs N: linear-scan allocate temps onto R1..RN (default 0: every op via R1, as before)
+//        --stream: lower and print one top-level statement at a time (bounded memory)
+//        --out FILE: write TAC/ASM to FILE instead of stdout
+//        --incremental FILE: like --stream, reusing TAC of statements unchanged since the last run
+//        --cache-dir DIR: reuse lowered TAC for unchanged sources (binary, mmap'd on a hit)
+//        --pipeline: like --stream, with lexer, parser and codegen overlapped on three threads
+//        --parallel [N]: at -O0, lower top-level statements on N threads (default and cap: all cores)
+//        --stats [json]: per-phase wall time and peak RSS plus counters, to stderr
+//        --ll1: parse with the LL(1) table generated from the language's grammar (no recursion)
+//        -O1: fold constants and identities, propagate constants and copies, drop dead temps,
+//             evaluate heavier operands first (Sethi-Ullman) and reuse temps within an expression
+//        -O2: -O1 plus local value numbering (CSE) and loop-invariant code motion
+// BATCH: ./my_compiler [--asm|--x86-64] --batch a.src b.src ... [--jobs [N]] [--out DIR]   (N as for --parallel)
+//        ./my_compiler [--asm|--x86-64] --batch-list list.txt   (writes a.tac / a.asm / a.s)
+// X86:   ./my_compiler --x86-64 prog.src --out prog.s && as prog.s -o prog.o && ld prog.o -o prog
+// RUN:   ./my_compiler --run prog.src       (register bytecode, direct-threaded interpreter)
+// JIT:   ./my_compiler --run-jit prog.src   (same code generated into memory and run in-process)
 // GR:    ./my_compiler --demo-grammar
+//        ./my_compiler --grammar file.g [--out FILE]   (`A -> x y | z` rules, see read_grammar)
+// BENCH: ./my_compiler --bench [keywords|scan|symtab|emit|run|firstfollow|leftfactor|programs|grammars|all]
+//        ./my_compiler --gen-src decls|nest|expr|loop|mixed N [--out FILE]   (N-statement program)
+//        ./my_compiler --gen-grammar wide|deep|long N [--out FILE]          (N-nonterminal grammar)
 
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if !defined(MINI_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define LEX_SIMD 32
+#elif !defined(MINI_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LEX_SIMD 16
+#endif
 using namespace std;
 
 /*==============================*
- * 1) TOKENS & MANUAL LEXER     *
+ * 1) SOURCE, TOKENS & LEXER    *
  *==============================*/
+// Whole input as one contiguous buffer: mmap'd from a path, slurped from stdin otherwise.
+// Tokens are string_view slices into it, so it must outlive the Lexer/Parser.
+struct Source {
+    explicit Source(const string& path){
+        if(path.empty()){ owned.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>()); p=owned.data(); n=owned.size(); return; }
+        int fd=::open(path.c_str(), O_RDONLY);
+        if(fd<0) throw runtime_error("Cannot open "+path);
+        struct stat st{};
+        if(fstat(fd,&st)<0){ ::close(fd); throw runtime_error("Cannot stat "+path); }
+        if(!S_ISREG(st.st_mode)){   // pipes, /dev/fd/N: nothing to map, read it through
+            char buf[1<<16];
+            for(ssize_t r; (r=::read(fd, buf, sizeof buf))!=0; ){
+                if(r>0){ owned.append(buf, (size_t)r); continue; }
+                if(errno==EINTR) continue;
+                ::close(fd); throw runtime_error("Cannot read "+path);   // a directory, say
+            }
+            ::close(fd); p=owned.data(); n=owned.size(); return;
+        }
+        n=(size_t)st.st_size;
+        if(n){
+            map=mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map==MAP_FAILED){ ::close(fd); throw runtime_error("Cannot mmap "+path); }
+            madvise(map, n, MADV_SEQUENTIAL);
+            p=(const char*)map;
+        }
+        ::close(fd);
+    }
+    ~Source(){ if(map) munmap(map, n); }
+    Source(const Source&)=delete; Source& operator=(const Source&)=delete;
+    string_view view() const { return {p,n}; }
+private:
+    const char* p=""; size_t n=0; void* map=nullptr; string owned;
+};
+
+// Where a file is written before it is renamed over `path`: unique per process and per
+// call, so concurrent runs and --batch jobs never share one. Sink, TACCache::save and
+// IncrementalState::save all go through it.
+static string temp_path(const string& path){
+    static atomic<unsigned> seq{0};
+    return path+".tmp"+to_string(getpid())+"."+to_string(seq++);
+}
+
+// Buffered output straight to a file descriptor (stdout for an empty path): one write()
+// per 1 MB flush, integers through to_chars, no iostream formatting. A file is written
+// under a temp name and renamed over `path` by close(), so a run that fails (the Sink
+// goes away without close()) unlinks it and leaves neither a partial nor an empty file.
+// Anything but a plain file (/dev/null, /dev/stdout, a FIFO, a symlink) is written in place.
+struct Sink {
+    explicit Sink(const string& path=""): buf(new char[Cap]) {
+        if(path.empty()) return;
+        struct stat st{};
+        if(::lstat(path.c_str(), &st)==0 && !S_ISREG(st.st_mode)) fd=::open(path.c_str(), O_WRONLY|O_TRUNC);
+        else {
+            tmp=temp_path(path); target=path;
+            fd=::open(tmp.c_str(), O_WRONLY|O_CREAT|O_EXCL, 0644);
+        }
+        if(fd<0) throw runtime_error("Cannot open "+path);
+        owned=true;
+    }
+    ~Sink(){
+        if(!tmp.empty()){ if(owned) ::close(fd); unlink(tmp.c_str()); return; }
+        try{ flush(); }catch(...){}
+        if(owned) ::close(fd);
+    }
+    Sink(const Sink&)=delete; Sink& operator=(const Sink&)=delete;
+    Sink& operator<<(string_view s){
+        if(s.size()>Cap-len){ flush(); if(s.size()>Cap){ write_all(s.data(), s.size()); return *this; } }
+        memcpy(buf.get()+len, s.data(), s.size()); len+=s.size(); return *this;
+    }
+    Sink& operator<<(char c){ if(len==Cap) flush(); buf[len++]=c; return *this; }
+    Sink& operator<<(int v){
+        if(Cap-len<12) flush();
+        len=size_t(to_chars(buf.get()+len, buf.get()+Cap, v).ptr-buf.get()); return *this;
+    }
+    void flush(){ write_all(buf.get(), len); len=0; }
+    void close(){
+        flush();
+        if(owned && ::close(fd)<0) throw runtime_error("close failed");
+        owned=false;
+        if(tmp.empty()) return;
+        if(rename(tmp.c_str(), target.c_str())<0) throw runtime_error("Cannot write "+target+": "+strerror(errno));
+        tmp.clear();
+    }
+    size_t bytes() const { return written+len; }
+private:
+    void write_all(const char* p, size_t n){
+        while(n){
+            ssize_t w=::write(fd, p, n);
+            if(w<0){ if(errno==EINTR) continue; throw runtime_error(string("write failed: ")+strerror(errno)); }
+            p+=w; n-=(size_t)w; written+=(size_t)w;
+        }
+    }
+    static constexpr size_t Cap=1<<20;
+    unique_ptr<char[]> buf; size_t len=0, written=0; int fd=1; bool owned=false;
+    string tmp, target;   // tmp non-empty until close() has renamed it to target
+};
+
+// --stats: wall time and peak RSS per phase plus pipeline counters, printed to stderr as
+// a table or one JSON object. Phases are timed at their boundaries only, through the
+// global `stats` that stays null without the flag: a PhaseTimer is then one untaken
+// branch, and nothing inside the lexer, parser or passes is instrumented.
+struct Stats {
+    enum Phase { Read, Lex, Parse, Gen, Lvn, CopyProp, Coalesce, DeadTemps, Licm, ReuseTemps, Emit, Phases };
+    static constexpr const char* names[Phases]={"read","lex","parse","gen","lvn","copy_propagate",
+        "coalesce_copies","eliminate_dead_temps","hoist_loop_invariants","reuse_temps","emit"};
+    bool json=false;
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    double ms[Phases]{}; long peak_kb[Phases]{}; uint64_t runs[Phases]{};
+    uint64_t tokens=0, nodes=0, instrs=0, temps=0, labels=0, bytes=0;
+    uint64_t symbols=0, slots=0, max_probe=0; double mean_probe=0;
+    bool replayed=false;          // a --cache-dir hit: nothing was lexed, parsed or looked up
+    long rss_kb=0; chrono::steady_clock::time_point sampled{};   // getrusage at most once a millisecond
+
+    static long peak_rss_kb(){ rusage u{}; getrusage(RUSAGE_SELF, &u); return u.ru_maxrss; }
+    void print() const {
+        double total=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+        double load= slots? double(symbols)/double(slots): 0;
+        auto front=[&](double v){ return replayed? NAN: v; };   // NaN prints as n/a (null in json)
+        pair<const char*, double> counters[]={{"tokens",front(double(tokens))},{"ast_nodes",front(double(nodes))},
+            {"tac_instrs",double(instrs)},{"temps",double(temps)},{"labels",double(labels)},
+            {"symbols",front(double(symbols))},{"symtab_slots",front(double(slots))},{"symtab_load",front(load)},
+            {"symtab_mean_probe",front(mean_probe)},{"symtab_max_probe",front(double(max_probe))},{"bytes_written",double(bytes)}};
+        char line[160];
+        if(json){
+            string j="{\"total_ms\":"; snprintf(line, sizeof line, "%.3f,\"peak_rss_kb\":%ld,\"phases\":{", total, peak_rss_kb()); j+=line;
+            for(int p=0; p<Phases; ++p){
+                snprintf(line, sizeof line, "%s\"%s\":{\"ms\":%.3f,\"runs\":%llu,\"peak_rss_kb\":%ld}", p? ",": "",
+                         names[p], ms[p], (unsigned long long)runs[p], peak_kb[p]);
+                j+=line;
+            }
+            j+="},\"counters\":{";
+            for(auto& [k,v]: counters){
+                if(isnan(v)) snprintf(line, sizeof line, "\"%s\":null,", k);
+                else snprintf(line, sizeof line, v==floor(v)? "\"%s\":%.0f,": "\"%s\":%.4f,", k, v);
+                j+=line;
+            }
+            j.pop_back();
+            cerr << j << "}}\n";
+            return;
+        }
+        cerr << "stats: phase                       ms      runs  peak RSS KB\n";
+        for(int p=0; p<Phases; ++p) if(runs[p]){
+            snprintf(line, sizeof line, "stats: %-22s %10.3f %9llu %12ld\n", names[p], ms[p], (unsigned long long)runs[p], peak_kb[p]);
+            cerr << line;
+        }
+        snprintf(line, sizeof line, "stats: %-22s %10.3f %9s %12ld\n", "total", total, "", peak_rss_kb()); cerr << line;
+        for(auto& [k,v]: counters){
+            if(isnan(v)) snprintf(line, sizeof line, "stats: %-22s n/a\n", k);
+            else snprintf(line, sizeof line, v==floor(v)? "stats: %-22s %.0f\n": "stats: %-22s %.4f\n", k, v);
+            cerr << line;
+        }
+    }
+};
+static Stats* stats=nullptr;   // set by --stats
+struct PhaseTimer {
+    explicit PhaseTimer(Stats::Phase p): p(p) { if(stats) t0=chrono::steady_clock::now(); }
+    ~PhaseTimer(){
+        if(!stats) return;
+        auto now=chrono::steady_clock::now();
+        stats->ms[p]+=chrono::duration<double, milli>(now-t0).count();
+        if(now-stats->sampled>=chrono::milliseconds(1)){ stats->rss_kb=Stats::peak_rss_kb(); stats->sampled=now; }
+        stats->peak_kb[p]=stats->rss_kb; ++stats->runs[p];
+    }
+    PhaseTimer(const PhaseTimer&)=delete; PhaseTimer& operator=(const PhaseTimer&)=delete;
+private:
+    Stats::Phase p; chrono::steady_clock::time_point t0;
+};
+
+// Identifiers interned to dense IDs (1..N, 0 = none). The text is copied once into
+// stable chunks; everything downstream carries the ID and only the printers resolve it.
+// One thread interns; --pipeline resolves names on another, so the ID -> text table is
+// published through an atomic pointer and outgrown tables stay alive until the end.
+// Lookup is open addressing over 16-byte slots, linear probing at under 1/2 load. A name
+// of up to 7 bytes is packed, with its length, into one word that the slot holds, so a
+// hit on it is a single compare and never touches the text; longer names compare their
+// text after a hash match. The Lexer builds the key right after scanning an identifier,
+// while its bytes are still in L1.
+struct Interner {
+    struct Key { uint64_t word; uint32_t hash; };   // word 0: longer than 7 bytes
+    // Overlapping loads cover every length, so no byte past the end is read.
+    static Key key(string_view s){
+        const char* p=s.data(); size_t n=s.size();
+        auto load=[](const char* q, auto w){ memcpy(&w, q, sizeof w); return uint64_t(w); };
+        auto mix=[](uint64_t h, uint64_t w){ h=(h^w)*0xFF51AFD7ED558CCDull; return h^(h>>32); };
+        if(n<8){
+            uint64_t w= n>=4? load(p, uint32_t{}) | load(p+n-4, uint32_t{})<<(8*(n-4))
+                      : n?   uint64_t(uint8_t(p[0])) | uint64_t(uint8_t(p[n>>1]))<<(8*(n>>1)) | uint64_t(uint8_t(p[n-1]))<<(8*(n-1))
+                      : 0;
+            w|=uint64_t(n)<<56;
+            return {w, uint32_t(mix(0x9E3779B97F4A7C15ull, w))};
+        }
+        uint64_t h=0x9E3779B97F4A7C15ull^n;
+        for(size_t k=0; k+8<n; k+=8) h=mix(h, load(p+k, uint64_t{}));
+        return {0, uint32_t(mix(h, load(p+n-8, uint64_t{})))};
+    }
+    Interner(){ append({}); slots.assign(2048, Slot{}); }
+    uint32_t intern(string_view s){ return intern(s, key(s)); }
+    uint32_t intern(string_view s, Key k){
+        size_t mask=slots.size()-1;
+        for(size_t p=k.hash&mask;; p=(p+1)&mask){
+            const Slot& e=slots[p];
+            if(!e.id) break;
+            if(e.hash==k.hash && e.word==k.word && (k.word || name(e.id)==s)) return e.id;
+        }
+        uint32_t id=(uint32_t)count;
+        append(store(s));
+        if(count*2>slots.size()) grow();
+        mask=slots.size()-1;
+        size_t p=k.hash&mask; while(slots[p].id) p=(p+1)&mask;
+        slots[p]=Slot{k.word, k.hash, id};
+        return id;
+    }
+    string_view name(uint32_t id) const { return names.load(memory_order_acquire)[id]; }
+    size_t size() const { return count-1; }
+private:
+    void append(string_view k){
+        string_view* t=names.load(memory_order_relaxed);
+        if(count==cap){
+            cap=max<size_t>(cap*2, 1024);
+            tables.emplace_back(new string_view[cap]);
+            copy(t, t+count, tables.back().get());
+            t=tables.back().get();
+        }
+        t[count++]=k;
+        names.store(t, memory_order_release);
+    }
+    void grow(){
+        vector<Slot> old(slots.size()*2);
+        old.swap(slots); size_t mask=slots.size()-1;
+        for(Slot e: old) if(e.id){ size_t p=e.hash&mask; while(slots[p].id) p=(p+1)&mask; slots[p]=e; }
+    }
+    vector<unique_ptr<string_view[]>> tables; atomic<string_view*> names{nullptr}; size_t count=0, cap=0;
+    string_view store(string_view s){
+        if(left<s.size()){
+            size_t sz=max<size_t>(s.size(), 64<<10);
+            chunks.emplace_back(new char[sz]); head=chunks.back().get(); left=sz;
+        }
+        memcpy(head, s.data(), s.size());
+        string_view k(head, s.size()); head+=s.size(); left-=s.size();
+        return k;
+    }
+    struct Slot { uint64_t word=0; uint32_t hash=0, id=0; };   // id 0: empty
+    vector<Slot> slots;
+    vector<unique_ptr<char[]>> chunks; char* head=nullptr; size_t left=0;
+};
+static Interner global_interner;
+static thread_local Interner* active_interner=&global_interner;
+static Interner& interner(){ return *active_interner; }
+static string name_of(uint32_t id){ return string(interner().name(id)); }
+// Gives the calling thread a private interner for the scope's lifetime (one per --batch job).
+struct InternerScope {
+    InternerScope(): prev(active_interner){ active_interner=&own; }
+    ~InternerScope(){ active_interner=prev; }
+    InternerScope(const InternerScope&)=delete; InternerScope& operator=(const InternerScope&)=delete;
+private:
+    Interner own; Interner* prev;
+};
+
 enum class Tok {
     End, Id, Num,
     KwInt, KwIf, KwElse, KwWhile, KwPrint,
     Plus, Minus, Mul, Div,
     Assign, LParen, RParen, LBrace, RBrace, Semicolon
 };
-struct Token { Tok t; string lex; int line, col; };
+struct Token { Tok t; string_view lex; int line, col; uint32_t sym=0; };  // sym: Id only
+
+// Keywords by length + first char: a miss usually costs no string compare, a hit exactly one.
+static constexpr Tok keyword(string_view id){
+    switch(id.size()){
+        case 2: return id[0]=='i' && id=="if"    ? Tok::KwIf    : Tok::Id;
+        case 3: return id[0]=='i' && id=="int"   ? Tok::KwInt   : Tok::Id;
+        case 4: return id[0]=='e' && id=="else"  ? Tok::KwElse  : Tok::Id;
+        case 5: if(id[0]=='w') return id=="while"? Tok::KwWhile : Tok::Id;
+                if(id[0]=='p') return id=="print"? Tok::KwPrint : Tok::Id;
+                return Tok::Id;
+    }
+    return Tok::Id;
+}
+static_assert(keyword("while")==Tok::KwWhile && keyword("whilst")==Tok::Id && keyword("pr1nt")==Tok::Id);
+
+// Byte classes (C-locale isspace/isalpha/isdigit) as a table instead of <cctype> calls.
+enum : uint8_t { CWs=1, CAlpha=2, CDigit=4, CId0=CAlpha, CIdn=CAlpha|CDigit };
+static constexpr array<uint8_t,256> make_char_classes(){
+    array<uint8_t,256> t{};
+    for(int c='a';c<='z';++c) t[c]=CAlpha;
+    for(int c='A';c<='Z';++c) t[c]=CAlpha;
+    for(int c='0';c<='9';++c) t[c]=CDigit;
+    t['_']=CAlpha;
+    for(unsigned char c: {' ','\t','\n','\v','\f','\r'}) t[c]=CWs;
+    return t;
+}
+static constexpr auto cclass = make_char_classes();
+
+#ifdef LEX_SIMD
+// Per-byte class masks over LEX_SIMD bytes (bit k = byte k). Unsigned range checks are
+// done as min_epu8(x-lo, hi-lo)==x-lo, which SSE2 has and AVX2 widens.
+#if LEX_SIMD==32
+using vbytes = __m256i;
+static inline vbytes vload(const char* p){ return _mm256_loadu_si256((const __m256i*)p); }
+static inline vbytes vset(char c){ return _mm256_set1_epi8(c); }
+static inline vbytes vinrange(vbytes c, char lo, char span){ vbytes x=_mm256_sub_epi8(c,vset(lo)); return _mm256_cmpeq_epi8(_mm256_min_epu8(x,vset(span)),x); }
+static inline vbytes veq(vbytes a, char c){ return _mm256_cmpeq_epi8(a,vset(c)); }
+static inline vbytes vor(vbytes a, vbytes b){ return _mm256_or_si256(a,b); }
+static inline uint32_t vmask(vbytes v){ return (uint32_t)_mm256_movemask_epi8(v); }
+#else
+using vbytes = __m128i;
+static inline vbytes vload(const char* p){ return _mm_loadu_si128((const __m128i*)p); }
+static inline vbytes vset(char c){ return _mm_set1_epi8(c); }
+static inline vbytes vinrange(vbytes c, char lo, char span){ vbytes x=_mm_sub_epi8(c,vset(lo)); return _mm_cmpeq_epi8(_mm_min_epu8(x,vset(span)),x); }
+static inline vbytes veq(vbytes a, char c){ return _mm_cmpeq_epi8(a,vset(c)); }
+static inline vbytes vor(vbytes a, vbytes b){ return _mm_or_si128(a,b); }
+static inline uint32_t vmask(vbytes v){ return (uint32_t)_mm_movemask_epi8(v); }
+#endif
+static constexpr uint32_t VFULL = LEX_SIMD==32? 0xFFFFFFFFu: 0xFFFFu;
+static inline uint32_t ws_mask(vbytes c){ return vmask(vor(vinrange(c,'\t',4), veq(c,' '))); }
+static inline uint32_t idn_mask(vbytes c){
+    vbytes lower=vor(c,vset(0x20));
+    return vmask(vor(vor(vinrange(lower,'a',25), vinrange(c,'0',9)), veq(c,'_')));
+}
+#endif
 
 struct Lexer {
-    string s; int i=0, n=0, line=1, col=1;
-    unordered_set<string> kw = {"int","if","else","while","print"};
-    Lexer(const string& src): s(src), n((int)src.size()) {}
+    string_view s; size_t i=0, n=0; int line=1, col=1;
+    explicit Lexer(string_view src): s(src), n(src.size()) {}
     char peek() const { return i<n? s[i]: '\0'; }
     char get() { char c=peek(); if(!c) return c; i++; if(c=='\n'){line++; col=1;} else col++; return c; }
-    static bool isid0(char c){ return isalpha((unsigned char)c) || c=='_'; }
-    static bool isidn(char c){ return isalnum((unsigned char)c) || c=='_'; }
+    static bool isid0(char c){ return cclass[(unsigned char)c]&CId0; }
+    static bool isidn(char c){ return cclass[(unsigned char)c]&CIdn; }
+
+    // Skip a whitespace run a vector at a time; newlines are counted with popcount and
+    // col restarts after the last one in the run.
+    void skip_ws(){
+#ifdef LEX_SIMD
+        while(i+LEX_SIMD<=n){
+            vbytes c=vload(s.data()+i);
+            uint32_t m=ws_mask(c);
+            uint32_t run = m==VFULL? LEX_SIMD: (uint32_t)__builtin_ctz(~m);
+            uint32_t nl = vmask(veq(c,'\n')) & (run==32? ~0u: (1u<<run)-1);
+            if(nl){ line+=__builtin_popcount(nl); col=1+(int)(run-1-(31-__builtin_clz(nl))); }
+            else col+=(int)run;
+            i+=run;
+            if(run<LEX_SIMD) return;
+        }
+#endif
+        while(cclass[(unsigned char)peek()]&CWs) get();
+    }
+    // Identifier chars never include '\n', so only col moves.
+    void skip_idn(){
+#ifdef LEX_SIMD
+        while(i+LEX_SIMD<=n){
+            uint32_t m=idn_mask(vload(s.data()+i));
+            uint32_t run = m==VFULL? LEX_SIMD: (uint32_t)__builtin_ctz(~m);
+            i+=run; col+=(int)run;
+            if(run<LEX_SIMD) return;
+        }
+#endif
+        while(i<n && isidn(s[i])){ i++; col++; }
+    }
 
     Token next() {
-        while(isspace((unsigned char)peek())) get();
+        skip_ws();
         int L=line, C=col; char c=peek();
-        if(!c) return {Tok::End,"",L,C};
+        if(!c) return {Tok::End,{},L,C};
 
-        if(isdigit((unsigned char)c)){
-            string num; while(isdigit((unsigned char)peek())) num+=get();
-            return {Tok::Num,num,L,C};
+        size_t b=i;
+        if(cclass[(unsigned char)c]&CDigit){
+            while(i<n && (cclass[(unsigned char)s[i]]&CDigit)){ i++; col++; }
+            return {Tok::Num,s.substr(b,i-b),L,C};
         }
         if(isid0(c)){
-            string id; id+=get();
-            while(isidn(peek())) id+=get();
-            if(kw.count(id)){
-                if(id=="int")   return {Tok::KwInt,id,L,C};
-                if(id=="if")    return {Tok::KwIf,id,L,C};
-                if(id=="else")  return {Tok::KwElse,id,L,C};
-                if(id=="while") return {Tok::KwWhile,id,L,C};
-                if(id=="print") return {Tok::KwPrint,id,L,C};
+            skip_idn();
+            string_view id=s.substr(b,i-b);
+            Tok k=keyword(id);
+            return {k,id,L,C, k==Tok::Id? interner().intern(id, Interner::key(id)): 0};
+        }
+        get();
+        string_view p=s.substr(b,1);
+        switch(c){
+            case '+': return {Tok::Plus,p,L,C};
+            case '-': return {Tok::Minus,p,L,C};
+            case '*': return {Tok::Mul,p,L,C};
+            case '/': return {Tok::Div,p,L,C};
+            case '=': return {Tok::Assign,p,L,C};
+            case '(': return {Tok::LParen,p,L,C};
+            case ')': return {Tok::RParen,p,L,C};
+            case '{': return {Tok::LBrace,p,L,C};
+            case '}': return {Tok::RBrace,p,L,C};
+            case ';': return {Tok::Semicolon,p,L,C};
+        }
+        throw runtime_error("Unknown character at "+to_string(L)+":"+to_string(C));
+    }
+};
+
+// Single-producer/single-consumer ring of N slots (a power of two) between --pipeline
+// stages. Slots stay allocated and are filled in place: the producer owns slot tail%N
+// until its release store of tail publishes it, the consumer owns head%N until it hands
+// it back through head. The indices sit on their own cache lines; a wait spins (only when
+// there is a core to spin against), then yields, and gives up with nullptr once `stop`.
+template<class T, size_t N> struct SpscRing {
+    static_assert((N&(N-1))==0, "ring size must be a power of two");
+    T* producer_slot(const atomic<bool>& stop){
+        size_t t=tail.load(memory_order_relaxed);
+        for(unsigned k=0; t-head.load(memory_order_acquire)==N; ++k) if(!wait(stop, k)) return nullptr;
+        return &slot[t&(N-1)];
+    }
+    void publish(){ tail.store(tail.load(memory_order_relaxed)+1, memory_order_release); }
+    T* consumer_slot(const atomic<bool>& stop){
+        size_t h=head.load(memory_order_relaxed);
+        for(unsigned k=0; tail.load(memory_order_acquire)==h; ++k) if(!wait(stop, k)) return nullptr;
+        return &slot[h&(N-1)];
+    }
+    void release(){ head.store(head.load(memory_order_relaxed)+1, memory_order_release); }
+private:
+    static bool wait(const atomic<bool>& stop, unsigned k){
+        static const unsigned spins=thread::hardware_concurrency()>1? 256: 0;
+        if(stop.load(memory_order_relaxed)) return false;
+        if(k>=spins) this_thread::yield();
+        return true;
+    }
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) array<T, N> slot{};
+};
+
+// Parser's token source under --pipeline: the Lexer runs on its own thread and ships
+// tokens in batches. A lexer error rides in its batch and is thrown from next() at the
+// token where the Lexer itself would have thrown; after End, End repeats like Lexer's.
+struct TokenBatch {
+    static constexpr uint32_t Cap=2048;
+    array<Token, Cap> tok; uint32_t n=0; bool failed=false; string error;
+};
+struct TokenStream {
+    using Ring=SpscRing<TokenBatch, 16>;
+    TokenStream(Ring& r, const atomic<bool>& stop): ring(r), stop(stop) {}
+    Token next(){
+        if(last.t==Tok::End && b) return last;
+        while(!b || at==b->n){
+            if(b){ if(b->failed) throw runtime_error(b->error); ring.release(); }
+            b=ring.consumer_slot(stop); at=0;
+            if(!b) throw runtime_error("pipeline stopped");
+        }
+        last=b->tok[at++];
+        return last;
+    }
+private:
+    Ring& ring; const atomic<bool>& stop;
+    TokenBatch* b=nullptr; uint32_t at=0; Token last{Tok::Id, {}, 0, 0};
+};
+
+/*===============================================*
+ * 2) HASH-BASED SYMBOL TABLE (ROBIN HOOD PROBING) *
+ *===============================================*/
+enum class Type : uint8_t { Int };
+// value/constant: last value assigned when it is a compile-time constant (-O1 propagation).
+struct Sym { uint32_t name=0; int value=0; uint32_t depth=0; Type type=Type::Int; bool initialized=false, constant=false; };
+
+// Open addressing over interned IDs (name 0 marks an empty slot), Robin Hood insertion
+// and backward-shift erase, doubling at 7/8 load. Scopes are an undo log: an inner
+// declaration overwrites the slot in place and pop_scope() restores or erases it.
+// Sym* from find() is invalidated by the next declare()/pop_scope().
+struct SymbolTable {
+    explicit SymbolTable(size_t cap=64){ size_t c=16; while(c<cap) c<<=1; slots.assign(c,Sym{}); mask=c-1; }
+    bool declare(uint32_t name, Type type){
+        if(Sym* e=find(name)){
+            if(e->depth==depth) return false;
+            undo.push_back({*e,true});
+            *e=Sym{name,0,depth,type,false};
+            return true;
+        }
+        if((count+1)*8 > slots.size()*7) grow();
+        insert(Sym{name,0,depth,type,false});
+        if(depth) undo.push_back({Sym{name},false});
+        return true;
+    }
+    Sym* find(uint32_t name){
+        for(size_t p=home(name), d=0;; p=(p+1)&mask, ++d){
+            Sym& e=slots[p];
+            if(!e.name || dist(e.name,p)<d) return nullptr;
+            if(e.name==name) return &e;
+        }
+    }
+    void push_scope(){ marks.push_back(undo.size()); ++depth; }
+    void pop_scope(){
+        for(size_t k=undo.size(); k-->marks.back(); ){
+            auto& u=undo[k];
+            if(u.shadowed) *find(u.prev.name)=u.prev; else erase(u.prev.name);
+        }
+        undo.resize(marks.back()); marks.pop_back(); --depth;
+    }
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    // Probe distance from each entry's home slot, longest and summed (--stats).
+    size_t probes(size_t& longest) const {
+        size_t sum=0; longest=0;
+        for(size_t p=0; p<slots.size(); ++p) if(slots[p].name){ size_t d=dist(slots[p].name,p); sum+=d; longest=max(longest,d); }
+        return sum;
+    }
+private:
+    struct Undo { Sym prev; bool shadowed; };
+    size_t home(uint32_t k) const { return (k*0x9E3779B1u) & mask; }
+    size_t dist(uint32_t k, size_t p) const { return (p-home(k)) & mask; }
+    void insert(Sym e){
+        for(size_t p=home(e.name), d=0;; p=(p+1)&mask, ++d){
+            Sym& s=slots[p];
+            if(!s.name){ s=e; ++count; return; }
+            size_t sd=dist(s.name,p);
+            if(sd<d){ swap(s,e); d=sd; }
+        }
+    }
+    void erase(uint32_t name){
+        size_t p=home(name);
+        while(slots[p].name!=name) p=(p+1)&mask;
+        for(size_t q=(p+1)&mask; slots[q].name && dist(slots[q].name,q); p=q, q=(q+1)&mask) slots[p]=slots[q];
+        slots[p]=Sym{}; --count;
+    }
+    void grow(){
+        vector<Sym> old(slots.size()*2);
+        old.swap(slots); mask=slots.size()-1; count=0;
+        for(auto& e: old) if(e.name) insert(e);
+    }
+    vector<Sym> slots; size_t mask=0, count=0;
+    vector<Undo> undo; vector<size_t> marks; uint32_t depth=0;
+};
+
+/*=============================*
+ * 3) AST NODES & TAC EMITTER  *
+ *=============================*/
+// One TAC instruction in 16 bytes: opcode, three operand kinds, three 32-bit payloads.
+// Temps and labels are plain counters, variables interned IDs, literals immediates.
+enum class Op : uint8_t { Label, Goto, Ifz, Copy, Print, Add, Sub, Mul, Div };
+enum class Arg : uint8_t { None, Temp, Sym, Imm, Label };
+static const char* op_text(Op o){ static const char* T[]={"label","goto","ifz","=","print","+","-","*","/"}; return T[(int)o]; }
+
+struct Opnd {
+    Arg k=Arg::None; int32_t v=0;
+    static Opnd temp(int n){ return {Arg::Temp,n}; }
+    static Opnd sym(uint32_t id){ return {Arg::Sym,(int32_t)id}; }
+    static Opnd imm(int x){ return {Arg::Imm,x}; }
+    static Opnd label(int n){ return {Arg::Label,n}; }
+    explicit operator bool() const { return k!=Arg::None; }
+    bool operator==(const Opnd& o) const { return k==o.k && v==o.v; }
+    bool operator!=(const Opnd& o) const { return !(*this==o); }
+};
+static Sink& operator<<(Sink& os, Opnd o){
+    switch(o.k){
+        case Arg::None:  break;
+        case Arg::Temp:  os<<'t'<<o.v; break;
+        case Arg::Label: os<<'L'<<o.v; break;
+        case Arg::Sym:   os<<interner().name((uint32_t)o.v); break;
+        case Arg::Imm:   os<<o.v; break;
+    }
+    return os;
+}
+
+struct Instr{
+    Op op; Arg ka, kb, kr; int32_t a, b, r;
+    Instr(Op op, Opnd a1, Opnd a2, Opnd res): op(op), ka(a1.k), kb(a2.k), kr(res.k), a(a1.v), b(a2.v), r(res.v) {}
+    Opnd a1() const { return {ka,a}; }
+    Opnd a2() const { return {kb,b}; }
+    Opnd res() const { return {kr,r}; }
+    void set_a1(Opnd o){ ka=o.k; a=o.v; }
+    void set_a2(Opnd o){ kb=o.k; b=o.v; }
+    void set_res(Opnd o){ kr=o.k; r=o.v; }
+};
+static_assert(sizeof(Instr)==16 && is_trivially_copyable_v<Instr>, "Instr must stay a 16-byte POD");
+
+struct TAC {
+    vector<Instr> code; int tempCounter=0, labelCounter=0;
+    int opt=0;   // -O level seen by gen
+    bool resolved=false;   // --parallel: names already checked by resolve_names, gen skips it
+
+    int newTemp(){ return ++tempCounter; }
+    int newLabel(){ return ++labelCounter; }
+    void emit(Op op, Opnd a1={}, Opnd a2={}, Opnd res={}){ code.emplace_back(op,a1,a2,res); }
+    void dump(Sink& os) const {
+        for(auto &i: code){
+            switch(i.op){
+                case Op::Label: os<<i.res()<<":\n"; break;
+                case Op::Goto:  os<<"    goto "<<i.res()<<"\n"; break;
+                case Op::Ifz:   os<<"    ifz "<<i.a1()<<" goto "<<i.res()<<"\n"; break;
+                case Op::Copy:  os<<"    "<<i.res()<<" = "<<i.a1()<<"\n"; break;
+                case Op::Print: os<<"    print "<<i.a1()<<"\n"; break;
+                default:        os<<"    "<<i.res()<<" = "<<i.a1()<<" "<<op_text(i.op)<<" "<<i.a2()<<"\n"; break;
+            }
+        }
+    }
+};
+
+// Bump-pointer arena for AST nodes: carved from large blocks, freed all at once when the
+// arena goes away. Destructors never run, so nodes hold only PODs and arena pointers.
+struct Arena {
+    Arena()=default; Arena(const Arena&)=delete; Arena& operator=(const Arena&)=delete;
+    template<class T, class... A> T* make(A&&... a){
+        static_assert(is_trivially_destructible_v<T>, "arena nodes must be trivially destructible");
+        ++nodes; return new(alloc(sizeof(T), alignof(T))) T(forward<A>(a)...);
+    }
+    template<class T> T* copy(const T* first, size_t n){
+        if(!n) return nullptr;
+        T* p=(T*)alloc(sizeof(T)*n, alignof(T)); memcpy((void*)p, first, sizeof(T)*n); return p;
+    }
+    template<class T> T* copy(const vector<T>& v){ return copy(v.data(), v.size()); }
+    void* alloc(size_t sz, size_t al){
+        size_t pad=(al-(size_t)head%al)%al;
+        if(pad+sz>left){
+            size_t bs=max<size_t>(sz+al, 256<<10);
+            blocks.emplace_back(new char[bs]); head=blocks.back().get(); left=bs; total+=bs;
+            if(blocks.size()==1) first=bs;
+            pad=(al-(size_t)head%al)%al;
+        }
+        void* r=head+pad; head+=pad+sz; left-=pad+sz; return r;
+    }
+    // Keep only the first block and rewind into it; recycles the arena between statements.
+    void reset(){
+        if(blocks.empty()) return;
+        blocks.resize(1); head=blocks[0].get(); left=total=first;
+    }
+    // Trade blocks with `o`: --pipeline ships a filled arena downstream and keeps parsing
+    // into the spare one it got back.
+    void swap(Arena& o){
+        blocks.swap(o.blocks); std::swap(head,o.head); std::swap(left,o.left);
+        std::swap(total,o.total); std::swap(first,o.first);
+    }
+    size_t bytes() const { return total; }
+    size_t nodes=0;       // make() calls; copy()'s arrays are not nodes
+private:
+    vector<unique_ptr<char[]>> blocks; char* head=nullptr; size_t left=0, total=0, first=0;
+};
+
+// -O1 folding of an op on two immediates (32-bit wraparound); false when it has to stay a
+// runtime op, i.e. division by zero or INT_MIN/-1.
+static bool fold_binop(Op op, int x, int y, int& r){
+    uint32_t a=(uint32_t)x, b=(uint32_t)y;
+    switch(op){
+        case Op::Add: r=(int)(a+b); return true;
+        case Op::Sub: r=(int)(a-b); return true;
+        case Op::Mul: r=(int)(a*b); return true;
+        case Op::Div: if(y==0 || (x==INT_MIN && y==-1)) return false; r=x/y; return true;
+        default: return false;
+    }
+}
+// -O1 identities: x+0, 0+x, x-0, x*1, 1*x, x/1 -> x;  x*0, 0*x -> 0 unless x is a temp,
+// whose computation may be a division that has to fail at run time.
+static bool simplify_binop(Op op, Opnd x, Opnd y, Opnd& r){
+    auto is=[](Opnd o, int v){ return o.k==Arg::Imm && o.v==v; };
+    if(x.k==Arg::Imm && y.k==Arg::Imm){ int v; if(!fold_binop(op,x.v,y.v,v)) return false; r=Opnd::imm(v); return true; }
+    switch(op){
+        case Op::Add: if(is(y,0)){ r=x; return true; } if(is(x,0)){ r=y; return true; } break;
+        case Op::Sub: if(is(y,0)){ r=x; return true; } break;
+        case Op::Mul: if((is(x,0) && y.k!=Arg::Temp) || (is(y,0) && x.k!=Arg::Temp)){ r=Opnd::imm(0); return true; }
+                      if(is(y,1)){ r=x; return true; } if(is(x,1)){ r=y; return true; } break;
+        case Op::Div: if(is(y,1)){ r=x; return true; } break;
+        default: break;
+    }
+    return false;
+}
+
+// Nodes carry a kind tag; gen_expr/gen_stmt switch on it instead of going through a vtable.
+enum class NK : uint8_t { Num, Var, BinOp, Decl, Assign, Print, Block, If, While };
+struct Node{ NK k; explicit Node(NK k):k(k){} };
+struct Expr: Node{ using Node::Node; };
+struct Stmt: Node{ using Node::Node; };
+static Opnd gen_expr(Expr* e, TAC& t, SymbolTable& s);
+static void gen_stmt(Stmt* st, TAC& t, SymbolTable& s);
+
+// -O1 propagation keeps each variable's known constant in its Sym. Control flow saves it
+// for the names a branch assigns (so the else branch starts from the entry state) and
+// forgets it for whatever a branch or loop body may have changed. The name lists are
+// slices of gen_stmt's per-thread arrays.
+static void note_value(SymbolTable& s, uint32_t name, Opnd v){
+    if(Sym* p=s.find(name)){ p->initialized=true; p->constant=v.k==Arg::Imm; p->value=v.v; }
+}
+struct ConstState { uint32_t name; bool constant; int value; };
+static void save_consts(SymbolTable& s, const uint32_t* names, size_t n, vector<ConstState>& out){
+    for(size_t k=0;k<n;++k){ Sym* p=s.find(names[k]); out.push_back({names[k], p && p->constant, p? p->value: 0}); }
+}
+static void restore_consts(SymbolTable& s, const ConstState* v, size_t n){
+    for(size_t k=0;k<n;++k) if(Sym* p=s.find(v[k].name)){ p->constant=v[k].constant; p->value=v[k].value; }
+}
+static void forget_consts(SymbolTable& s, const uint32_t* names, size_t n){
+    for(size_t k=0;k<n;++k) if(Sym* p=s.find(names[k])) p->constant=false;
+}
+
+struct Num: Expr{
+    int v; explicit Num(int v):Expr(NK::Num),v(v){}
+    Opnd gen(TAC& t, SymbolTable&){
+        if(t.opt) return Opnd::imm(v);
+        Opnd tmp=Opnd::temp(t.newTemp()); t.emit(Op::Copy,Opnd::imm(v),{},tmp); return tmp;
+    }
+};
+struct Var: Expr{
+    uint32_t name; explicit Var(uint32_t n):Expr(NK::Var),name(n){}
+    Opnd gen(TAC& t, SymbolTable& s){
+        if(t.opt){ Sym* p=s.find(name); if(p && p->constant) return Opnd::imm(p->value); }
+        Opnd tmp=Opnd::temp(t.newTemp()); t.emit(Op::Copy,Opnd::sym(name),{},tmp); return tmp;
+    }
+};
+// su: Sethi-Ullman number, the temps needed to evaluate the tree when the heavier operand
+// goes first (a leaf needs one). Operands exist before their BinOp, so it is set here.
+static uint32_t su_need(const Expr* e);
+struct BinOp: Expr{
+    Op op; uint32_t su; Expr *a,*b;
+    BinOp(Op op, Expr* a, Expr* b):Expr(NK::BinOp),op(op),a(a),b(b){
+        uint32_t x=su_need(a), y=su_need(b); su= x==y? x+1: max(x,y);
+    }
+    // -O1 and up lower b first when it needs more temps than a.
+    bool b_first(const TAC& t) const { return t.opt && su_need(b)>su_need(a); }
+    // Operands already lowered by gen_expr, in whichever order b_first chose.
+    Opnd gen(TAC& t, Opnd x, Opnd y){
+        Opnd r;
+        if(t.opt && simplify_binop(op,x,y,r)) return r;
+        Opnd z=Opnd::temp(t.newTemp()); t.emit(op,x,y,z); return z;
+    }
+};
+static uint32_t su_need(const Expr* e){ return e->k==NK::BinOp? static_cast<const BinOp*>(e)->su: 1; }
+struct Decl: Stmt{
+    uint32_t name; Expr* init;
+    Decl(uint32_t n, Expr* e):Stmt(NK::Decl),name(n),init(e){}
+    void gen(TAC& t, SymbolTable& s){
+        if(!t.resolved && !s.declare(name,Type::Int)) throw runtime_error("Redeclaration: "+name_of(name));
+        if(init){ Opnd v=gen_expr(init,t,s); t.emit(Op::Copy,v,{},Opnd::sym(name)); note_value(s,name,v); }
+    }
+};
+struct Assign: Stmt{
+    uint32_t name; Expr* rhs;
+    Assign(uint32_t n, Expr* e):Stmt(NK::Assign),name(n),rhs(e){}
+    void gen(TAC& t, SymbolTable& s){
+        if(!t.resolved && !s.find(name)) throw runtime_error("Undeclared: "+name_of(name));
+        Opnd v=gen_expr(rhs,t,s); t.emit(Op::Copy,v,{},Opnd::sym(name)); note_value(s,name,v);
+    }
+};
+struct Print: Stmt{
+    Expr* e; explicit Print(Expr* e):Stmt(NK::Print),e(e){}
+    void gen(TAC& t, SymbolTable& s){
+        Opnd v=gen_expr(e,t,s); t.emit(Op::Print,v);
+    }
+};
+struct Block: Stmt{
+    Stmt** ss=nullptr; uint32_t n=0;
+    Block():Stmt(NK::Block){}
+    void gen(TAC& t, SymbolTable& s){ gen_stmt(this,t,s); }
+};
+// if and while are lowered by gen_stmt, which keeps their bodies off the C++ stack.
+struct IfStmt: Stmt{
+    Expr* cond; Stmt* thenS; Stmt* elseS;
+    IfStmt(Expr* c, Stmt* t, Stmt* e=nullptr):Stmt(NK::If),cond(c),thenS(t),elseS(e){}
+};
+struct WhileStmt: Stmt{
+    Expr* cond; Stmt* body;
+    WhileStmt(Expr* c, Stmt* b):Stmt(NK::While),cond(c),body(b){}
+};
+
+// Post-order on explicit stacks: a BinOp is visited once to queue its BinOp operands (a
+// leaf that goes first is lowered right away), once more with `emit` set to lower a leaf
+// that goes second and combine, so nesting costs heap, not C++ stack. Leaves never touch
+// the stacks, which are per thread and grow once. At -O0 a is lowered before b, as the
+// recursive lowering did; from -O1 the operand with the larger Sethi-Ullman number goes
+// first, which keeps the temps live at once down to BinOp::su (reuse_temps renames them).
+static Opnd gen_leaf(Expr* e, TAC& t, SymbolTable& s){
+    switch(e->k){
+        case NK::Num: return static_cast<Num*>(e)->gen(t,s);
+        case NK::Var: return static_cast<Var*>(e)->gen(t,s);
+        default: throw logic_error("gen_expr: not an expression");
+    }
+}
+static Opnd gen_expr(Expr* e, TAC& t, SymbolTable& s){
+    if(e->k!=NK::BinOp) return gen_leaf(e,t,s);
+    static thread_local vector<pair<BinOp*, bool>> tls_work;
+    static thread_local vector<Opnd> tls_vals;
+    auto& work=tls_work; auto& vals=tls_vals;
+    size_t wb=work.size(), vb=vals.size();
+    work.push_back({static_cast<BinOp*>(e), false});
+    while(work.size()>wb){
+        auto [b, emit]=work.back(); work.pop_back();
+        bool swapped=b->b_first(t);
+        Expr* first=swapped? b->b: b->a; Expr* second=swapped? b->a: b->b;
+        if(emit){
+            Opnd y;
+            if(second->k==NK::BinOp){ y=vals.back(); vals.pop_back(); } else y=gen_leaf(second,t,s);
+            Opnd x=vals.back();
+            vals.back()=swapped? b->gen(t, y, x): b->gen(t, x, y);
+            continue;
+        }
+        work.push_back({b, true});
+        if(second->k==NK::BinOp) work.push_back({static_cast<BinOp*>(second), false});
+        if(first->k==NK::BinOp) work.push_back({static_cast<BinOp*>(first), false});
+        else vals.push_back(gen_leaf(first,t,s));
+    }
+    Opnd r=vals.back(); vals.resize(vb); return r;
+}
+// Every name a statement mentions anywhere, for --incremental dependency keys.
+static void collect_names(Node* n, vector<uint32_t>& out){
+    vector<Node*> work{n};   // preorder, left to right
+    while(!work.empty()){
+        Node* x=work.back(); work.pop_back();
+        switch(x->k){
+            case NK::Num:    break;
+            case NK::Var:    out.push_back(static_cast<Var*>(x)->name); break;
+            case NK::BinOp:  work.push_back(static_cast<BinOp*>(x)->b); work.push_back(static_cast<BinOp*>(x)->a); break;
+            case NK::Decl:   { auto* d=static_cast<Decl*>(x); out.push_back(d->name); if(d->init) work.push_back(d->init); break; }
+            case NK::Assign: { auto* a=static_cast<Assign*>(x); out.push_back(a->name); work.push_back(a->rhs); break; }
+            case NK::Print:  work.push_back(static_cast<Print*>(x)->e); break;
+            case NK::Block:  { auto* b=static_cast<Block*>(x); for(uint32_t k=b->n;k--;) work.push_back(b->ss[k]); break; }
+            case NK::If:     { auto* i=static_cast<IfStmt*>(x); if(i->elseS) work.push_back(i->elseS); work.push_back(i->thenS); work.push_back(i->cond); break; }
+            case NK::While:  { auto* w=static_cast<WhileStmt*>(x); work.push_back(w->body); work.push_back(w->cond); break; }
+        }
+    }
+}
+
+// Every name each if and while under `st` may declare or assign, for -O1 invalidation at
+// control flow: sorted, unique [begin, end) slices of `pool`, keyed by statement. One
+// postorder walk covers all levels, so nested control flow is not re-walked per level.
+using Slice=pair<size_t, size_t>;
+static void collect_assigned(Stmt* st, vector<uint32_t>& pool, unordered_map<const Stmt*, Slice>& at){
+    vector<pair<Stmt*, bool>> work{{st, false}};
+    vector<Slice> vals;   // one per finished statement whose parent is still open
+    while(!work.empty()){
+        auto [x, done]=work.back(); work.pop_back();
+        size_t kids=0;
+        switch(x->k){
+            case NK::Decl:   pool.push_back(static_cast<Decl*>(x)->name); vals.push_back({pool.size()-1, pool.size()}); continue;
+            case NK::Assign: pool.push_back(static_cast<Assign*>(x)->name); vals.push_back({pool.size()-1, pool.size()}); continue;
+            case NK::Block: {
+                auto* b=static_cast<Block*>(x); kids=b->n;
+                if(!done){ work.push_back({x, true}); for(uint32_t k=b->n;k--;) work.push_back({b->ss[k], false}); continue; }
+                break;
+            }
+            case NK::If: {
+                auto* i=static_cast<IfStmt*>(x); kids= i->elseS? 2: 1;
+                if(!done){ work.push_back({x, true}); if(i->elseS) work.push_back({i->elseS, false}); work.push_back({i->thenS, false}); continue; }
+                break;
+            }
+            case NK::While:
+                kids=1;
+                if(!done){ work.push_back({x, true}); work.push_back({static_cast<WhileStmt*>(x)->body, false}); continue; }
+                break;
+            default: vals.push_back({0, 0}); continue;
+        }
+        size_t from=pool.size();
+        for(size_t k=vals.size()-kids; k<vals.size(); ++k)
+            for(size_t j=vals[k].first; j<vals[k].second; ++j){ uint32_t n=pool[j]; pool.push_back(n); }
+        sort(pool.begin()+from, pool.end()); pool.erase(unique(pool.begin()+from, pool.end()), pool.end());
+        vals.resize(vals.size()-kids); vals.push_back({from, pool.size()});
+        if(x->k!=NK::Block) at[x]=vals.back();
+    }
+}
+// Statements go on an explicit stack as expressions do: a Block queues its children, an
+// if or while is visited at step 0 to emit what precedes its body and once more after each
+// body (an if with else twice). At -O1 an if saves the entry constants of the names its
+// branches assign in a per-thread array, a slice it releases when it closes; a while
+// forgets its names on entry (back edge) and on exit (zero trips).
+static void gen_stmt(Stmt* st, TAC& t, SymbolTable& s){
+    struct Frame { Stmt* st; uint32_t step; Opnd L1, L2; Slice names; size_t saved; };   // if: else, end; while: head, end
+    static thread_local vector<Frame> tls_work;
+    static thread_local vector<uint32_t> tls_pool;
+    static thread_local unordered_map<const Stmt*, Slice> tls_assigned;
+    static thread_local vector<ConstState> tls_saved;
+    auto& work=tls_work; auto& pool=tls_pool; auto& assigned=tls_assigned; auto& saved=tls_saved;
+    if(t.opt && (st->k==NK::Block || st->k==NK::If || st->k==NK::While)){
+        pool.clear(); assigned.clear(); collect_assigned(st, pool, assigned);
+    }
+    auto forget=[&](Slice n){ forget_consts(s, pool.data()+n.first, n.second-n.first); };
+    size_t wb=work.size();
+    work.push_back({st, 0, {}, {}, {}, 0});
+    while(work.size()>wb){
+        Frame f=work.back(); work.pop_back();
+        switch(f.st->k){
+            case NK::Decl:   static_cast<Decl*>(f.st)->gen(t,s); break;
+            case NK::Assign: static_cast<Assign*>(f.st)->gen(t,s); break;
+            case NK::Print:  static_cast<Print*>(f.st)->gen(t,s); break;
+            case NK::Block:  { auto* b=static_cast<Block*>(f.st); for(uint32_t k=b->n;k--;) work.push_back({b->ss[k], 0, {}, {}, {}, 0}); break; }
+            case NK::If: {
+                auto* i=static_cast<IfStmt*>(f.st);
+                if(f.step==0){
+                    Opnd c=gen_expr(i->cond,t,s); f.L1=Opnd::label(t.newLabel()); f.L2=Opnd::label(t.newLabel());
+                    f.saved=saved.size();
+                    if(t.opt){ f.names=assigned.at(i); save_consts(s, pool.data()+f.names.first, f.names.second-f.names.first, saved); }
+                    t.emit(Op::Ifz,c,{},i->elseS? f.L1: f.L2);
+                    f.step=1; work.push_back(f); work.push_back({i->thenS, 0, {}, {}, {}, 0});
+                    break;
+                }
+                if(f.step==1 && i->elseS){
+                    t.emit(Op::Goto,{},{},f.L2); t.emit(Op::Label,{},{},f.L1);
+                    restore_consts(s, saved.data()+f.saved, saved.size()-f.saved);
+                    f.step=2; work.push_back(f); work.push_back({i->elseS, 0, {}, {}, {}, 0});
+                    break;
+                }
+                t.emit(Op::Label,{},{},f.L2);
+                forget(f.names); saved.resize(f.saved);
+                break;
+            }
+            case NK::While: {
+                auto* w=static_cast<WhileStmt*>(f.st);
+                if(f.step==0){
+                    f.L1=Opnd::label(t.newLabel()); f.L2=Opnd::label(t.newLabel());
+                    if(t.opt){ f.names=assigned.at(w); forget(f.names); }
+                    t.emit(Op::Label,{},{},f.L1);
+                    Opnd c=gen_expr(w->cond,t,s); t.emit(Op::Ifz,c,{},f.L2);
+                    f.step=1; work.push_back(f); work.push_back({w->body, 0, {}, {}, {}, 0});
+                    break;
+                }
+                t.emit(Op::Goto,{},{},f.L1);
+                t.emit(Op::Label,{},{},f.L2);
+                forget(f.names);
+                break;
+            }
+            default: throw logic_error("gen_stmt: not a statement");
+        }
+    }
+}
+
+/*=============================*
+ * 4) RECURSIVE-DESCENT PARSER *
+ *=============================*/
+// Lx is the token source: the Lexer itself, or a TokenStream fed by a Lexer thread.
+template<class Lx> struct BasicParser {
+    Lx lex; Token cur; Arena& A;
+    template<class S> BasicParser(S&& src, Arena& arena): lex(forward<S>(src)), A(arena) { cur=lex.next(); }
+    [[noreturn]] void err(const string& m){ throw runtime_error(m+" at line "+to_string(cur.line)); }
+    void eat(Tok t){ if(cur.t==t) cur=lex.next(); else err("Unexpected token: "+string(cur.lex)); }
+    bool accept(Tok t){ if(cur.t==t){ cur=lex.next(); return true;} return false; }
+
+    // Precedence climbing on explicit stacks instead of expr()/term()/factor() recursion:
+    // `ops` holds pending operators and open parentheses, `args` the operands. An operator
+    // first reduces everything on top of it that binds at least as tightly, which keeps
+    // * / above + - and both left-associative, so the BinOp tree is the one the old
+    // grammar built. The stacks are members, reused across expressions.
+    static constexpr Op Paren=Op::Label;
+    vector<Op> ops; vector<Expr*> args;
+    static int prec(Op o){ return o==Op::Mul || o==Op::Div? 2: o==Op::Add || o==Op::Sub? 1: 0; }
+    static bool binary(Tok t, Op& o){
+        switch(t){
+            case Tok::Plus: o=Op::Add; return true;  case Tok::Minus: o=Op::Sub; return true;
+            case Tok::Mul:  o=Op::Mul; return true;  case Tok::Div:   o=Op::Div; return true;
+            default: return false;
+        }
+    }
+    void reduce(){
+        Expr* b=args.back(); args.pop_back();
+        args.back()=A.make<BinOp>(ops.back(), args.back(), b); ops.pop_back();
+    }
+    Expr* expr(){
+        size_t ob=ops.size(), ab=args.size();
+        for(;;){
+            while(cur.t==Tok::LParen){ ops.push_back(Paren); eat(Tok::LParen); }
+            if(cur.t==Tok::Num){
+                int v=0; auto r=from_chars(cur.lex.data(), cur.lex.data()+cur.lex.size(), v);
+                if(r.ec!=errc()) err("Number out of range: "+string(cur.lex));
+                eat(Tok::Num); args.push_back(A.make<Num>(v));
+            }
+            else if(cur.t==Tok::Id){ args.push_back(A.make<Var>(cur.sym)); eat(Tok::Id); }
+            else err("Expected factor");
+            Op o;
+            for(;;){
+                if(binary(cur.t, o)){
+                    while(ops.size()>ob && ops.back()!=Paren && prec(ops.back())>=prec(o)) reduce();
+                    ops.push_back(o); eat(cur.t); break;
+                }
+                while(ops.size()>ob && ops.back()!=Paren) reduce();
+                if(ops.size()==ob){ Expr* e=args.back(); args.resize(ab); return e; }
+                eat(Tok::RParen); ops.pop_back();
+            }
+        }
+    }
+
+    // Statements nest on `open` rather than on the C++ stack, like expressions do on ops/
+    // args: if, while and { push a frame, and each finished statement is handed to the
+    // innermost frame until one of them needs another child. Block children wait in `kids`.
+    struct Open { NK k; Expr* cond; Stmt* thenS; size_t kids; };
+    vector<Open> open; vector<Stmt*> kids;
+    Stmt* statement(){
+        open.clear(); kids.clear();
+        for(;;){
+            Stmt* done=nullptr;
+            switch(cur.t){
+                case Tok::KwInt: {
+                    eat(Tok::KwInt);
+                    if(cur.t!=Tok::Id) err("Expected identifier");
+                    uint32_t name=cur.sym; eat(Tok::Id);
+                    Expr* init=nullptr;
+                    if(accept(Tok::Assign)) init=expr();
+                    eat(Tok::Semicolon);
+                    done=A.make<Decl>(name, init); break;
+                }
+                case Tok::Id: {
+                    uint32_t name=cur.sym; eat(Tok::Id); eat(Tok::Assign); Expr* e=expr(); eat(Tok::Semicolon);
+                    done=A.make<Assign>(name, e); break;
+                }
+                case Tok::KwPrint: {
+                    eat(Tok::KwPrint); eat(Tok::LParen); Expr* e=expr(); eat(Tok::RParen); eat(Tok::Semicolon);
+                    done=A.make<Print>(e); break;
+                }
+                case Tok::KwIf: case Tok::KwWhile: {
+                    NK k= cur.t==Tok::KwIf? NK::If: NK::While;
+                    eat(cur.t); eat(Tok::LParen); Expr* c=expr(); eat(Tok::RParen);
+                    open.push_back({k, c, nullptr, 0}); continue;
+                }
+                case Tok::LBrace:
+                    eat(Tok::LBrace);
+                    if(!accept(Tok::RBrace)){ open.push_back({NK::Block, nullptr, nullptr, kids.size()}); continue; }
+                    done=block(nullptr, 0); break;
+                default:
+                    err("Invalid statement");
+            }
+            while(!open.empty()){
+                Open& f=open.back();
+                if(f.k==NK::Block){
+                    kids.push_back(done);
+                    if(cur.t!=Tok::RBrace) break;
+                    eat(Tok::RBrace);
+                    done=block(kids.data()+f.kids, kids.size()-f.kids); kids.resize(f.kids);
+                }
+                else if(f.k==NK::While) done=A.make<WhileStmt>(f.cond, done);
+                else if(!f.thenS && accept(Tok::KwElse)){ f.thenS=done; break; }
+                else done= f.thenS? A.make<IfStmt>(f.cond, f.thenS, done): A.make<IfStmt>(f.cond, done, nullptr);
+                open.pop_back();
+            }
+            if(open.empty()) return done;
+        }
+    }
+    Block* block(Stmt* const* ss, size_t n){
+        Block* b=A.make<Block>(); b->ss=A.copy(ss, n); b->n=(uint32_t)n; return b;
+    }
+    Block* block(const vector<Stmt*>& ss){ return block(ss.data(), ss.size()); }
+
+    bool at_end() const { return cur.t==Tok::End; }
+    // Continue lexing at `p`, `newlines` lines below the current token (--incremental
+    // skips statements it already has TAC for without parsing them).
+    void resume_at(const char* p, int newlines){
+        size_t at=size_t(p-lex.s.data());
+        string_view skipped=lex.s.substr(size_t(cur.lex.data()-lex.s.data()), at-size_t(cur.lex.data()-lex.s.data()));
+        lex.line=cur.line+newlines;
+        lex.col= newlines? int(skipped.size()-skipped.rfind('\n')): cur.col+int(skipped.size());
+        lex.i=at; cur=lex.next();
+    }
+    Block* program(){
+        vector<Stmt*> ss;
+        while(!at_end()) ss.push_back(statement());
+        return block(ss);
+    }
+};
+using Parser=BasicParser<Lexer>;
+
+/*==========================================*
+ * 4b) TAC OPTIMIZATION PASSES (-O1 and up)  *
+ *==========================================*/
+// Which operand slots an op reads; Copy and the arithmetic ops define res, the branch ops
+// use it as a label.
+static bool reads_a1(Op op){ return op!=Op::Label && op!=Op::Goto; }
+static bool reads_a2(Op op){ return op>=Op::Add; }
+static bool defines(Op op){ return op==Op::Copy || op>=Op::Add; }
+// A division fails at run time on x/0 (and INT_MIN/-1 is left to the backend), so unless
+// the divisor is a safe immediate it is not free to delete or move.
+static bool may_trap(const Instr& i){ return i.op==Op::Div && (i.kb!=Arg::Imm || i.b==0 || i.b==-1); }
+
+// Temps of one TAC chunk lie in [lo,hi]; per-temp tables are indexed from lo so a --stream
+// chunk only pays for its own temps.
+struct TempRange {
+    int lo=INT_MAX, hi=INT_MIN;
+    explicit TempRange(const TAC& t){
+        auto see=[&](Arg k, int v){ if(k==Arg::Temp){ lo=min(lo,v); hi=max(hi,v); } };
+        for(const auto& i: t.code){ see(i.ka,i.a); see(i.kb,i.b); see(i.kr,i.r); }
+    }
+    size_t size() const { return hi>=lo? size_t(hi-lo)+1: 0; }
+    size_t operator()(int v) const { return size_t(v-lo); }
+};
+static vector<uint32_t> temp_uses(const TAC& t, const TempRange& R){
+    vector<uint32_t> u(R.size());
+    for(const auto& i: t.code){
+        if(reads_a1(i.op) && i.ka==Arg::Temp) ++u[R(i.a)];
+        if(reads_a2(i.op) && i.kb==Arg::Temp) ++u[R(i.b)];
+    }
+    return u;
+}
+static void drop_marked(TAC& t, const vector<char>& dead){
+    size_t w=0;
+    for(size_t k=0;k<t.code.size();++k) if(!dead[k]) t.code[w++]=t.code[k];
+    t.code.erase(t.code.begin()+(ptrdiff_t)w, t.code.end());
+}
+
+// Forward `tN = src` into later reads of tN. A fact dies at a label, when tN is redefined
+// or when src is written; version counters make each of those checks O(1).
+static void copy_propagate(TAC& t){
+    TempRange R(t);
+    vector<uint32_t> tver(R.size());
+    unordered_map<int32_t, uint32_t> sver;
+    struct Fact { Opnd src; uint32_t epoch=0, tv=0, sv=0; };
+    vector<Fact> fact(R.size());
+    uint32_t epoch=1;
+    auto ver=[&](Opnd o)->uint32_t{
+        if(o.k==Arg::Temp) return tver[R(o.v)];
+        if(o.k==Arg::Sym){ auto it=sver.find(o.v); return it==sver.end()? 0: it->second; }
+        return 0;
+    };
+    auto subst=[&](Opnd o){
+        if(o.k!=Arg::Temp) return o;
+        const Fact& f=fact[R(o.v)];
+        return f.epoch==epoch && f.tv==tver[R(o.v)] && f.sv==ver(f.src)? f.src: o;
+    };
+    for(auto& i: t.code){
+        if(i.op==Op::Label){ ++epoch; continue; }
+        if(reads_a1(i.op)) i.set_a1(subst(i.a1()));
+        if(reads_a2(i.op)) i.set_a2(subst(i.a2()));
+        if(!defines(i.op)) continue;
+        if(i.kr==Arg::Temp){
+            uint32_t v=++tver[R(i.r)];
+            if(i.op==Op::Copy && i.a1()!=i.res()) fact[R(i.r)]={i.a1(), epoch, v, ver(i.a1())};
+        }
+        else if(i.kr==Arg::Sym) ++sver[i.r];
+    }
+}
+
+// `tN = <rhs>; x = tN`, where that copy is tN's only read, becomes `x = <rhs>`.
+static void coalesce_copies(TAC& t){
+    TempRange R(t);
+    auto uses=temp_uses(t,R);
+    vector<char> dead(t.code.size());
+    for(size_t k=0;k+1<t.code.size();++k){
+        Instr& d=t.code[k]; const Instr& c=t.code[k+1];
+        if(!defines(d.op) || d.kr!=Arg::Temp || uses[R(d.r)]!=1) continue;
+        if(c.op!=Op::Copy || c.ka!=Arg::Temp || c.a!=d.r || c.kr!=Arg::Sym) continue;
+        d.set_res(c.res()); dead[++k]=1;
+    }
+    drop_marked(t,dead);
+}
+
+// Drop definitions of temps nobody reads (and `x = x`), except divisions that may trap.
+// Walking backwards releases the operands of a dropped instruction before their own
+// definitions are reached.
+static void eliminate_dead_temps(TAC& t){
+    TempRange R(t);
+    auto uses=temp_uses(t,R);
+    vector<char> dead(t.code.size());
+    for(size_t k=t.code.size(); k-->0; ){
+        const Instr& i=t.code[k];
+        if(!defines(i.op)) continue;
+        bool self=i.op==Op::Copy && i.a1()==i.res();
+        if(!self && (i.kr!=Arg::Temp || uses[R(i.r)] || may_trap(i))) continue;
+        dead[k]=1;
+        if(i.ka==Arg::Temp) --uses[R(i.a)];
+        if(reads_a2(i.op) && i.kb==Arg::Temp) --uses[R(i.b)];
+    }
+    drop_marked(t,dead);
+}
+
+// Basic blocks over TAC::code: a block starts at instruction 0, at every label and after
+// every goto/ifz. Built in one pass plus one pass for the edges; labels resolve through a
+// table indexed like TempRange.
+struct BasicBlock { size_t begin, end; vector<int> succ, pred; };
+struct CFG {
+    vector<BasicBlock> blocks;
+    vector<int> block_at;   // instruction index -> block
+    explicit CFG(const TAC& t){
+        size_t n=t.code.size(); block_at.assign(n,-1);
+        int lo=INT_MAX, hi=INT_MIN;
+        for(const auto& i: t.code) if(i.op==Op::Label){ lo=min(lo,i.r); hi=max(hi,i.r); }
+        vector<int> label_block(hi>=lo? size_t(hi-lo)+1: 0, -1);
+        for(size_t k=0;k<n;++k){
+            const Instr& i=t.code[k];
+            bool leader= k==0 || i.op==Op::Label || t.code[k-1].op==Op::Goto || t.code[k-1].op==Op::Ifz;
+            if(leader){ if(!blocks.empty()) blocks.back().end=k; blocks.push_back({k,n,{},{}}); }
+            block_at[k]=(int)blocks.size()-1;
+            if(i.op==Op::Label) label_block[size_t(i.r-lo)]=block_at[k];
+        }
+        auto edge=[&](int a, int b){ blocks[a].succ.push_back(b); blocks[b].pred.push_back(a); };
+        for(int b=0;b<(int)blocks.size();++b){
+            const Instr& last=t.code[blocks[b].end-1];
+            bool jumps=last.op==Op::Goto || last.op==Op::Ifz;
+            if(jumps){
+                int target= last.r>=lo && last.r<=hi? label_block[size_t(last.r-lo)]: -1;
+                if(target<0) throw logic_error("CFG: jump to undefined label");
+                edge(b,target);
+            }
+            if(last.op!=Op::Goto && b+1<(int)blocks.size()) edge(b,b+1);
+        }
+    }
+};
+
+// Local value numbering: inside each block, `r = a op b` whose (op, vn(a), vn(b)) was
+// already computed into a still-intact home becomes `r = home`; copy propagation and
+// dead-temp removal then clean up. Table entries are epoch-stamped per block rather than
+// cleared.
+static void local_value_numbering(TAC& t, const CFG& g){
+    struct Val { uint32_t vn, epoch; };
+    auto okey=[](Opnd o){ return (uint64_t(uint8_t(o.k))<<32) | uint32_t(o.v); };
+    unordered_map<uint64_t, Val> opnd_vn;                 // operand -> current value number
+    unordered_map<uint64_t, Val> expr_vn;                 // (op, vn, vn) -> value number
+    vector<Opnd> home;                                    // value number -> operand holding it
+    uint32_t epoch=0;
+    for(const auto& b: g.blocks){
+        ++epoch; home.clear();
+        auto vn_of=[&](Opnd o) -> uint32_t {
+            auto& e=opnd_vn[okey(o)];
+            if(e.epoch!=epoch){ e={(uint32_t)home.size(), epoch}; home.push_back(o); }
+            return e.vn;
+        };
+        auto set_vn=[&](Opnd o, uint32_t vn){ opnd_vn[okey(o)]={vn,epoch}; };
+        for(size_t k=b.begin;k<b.end;++k){
+            Instr& i=t.code[k];
+            if(!defines(i.op)) continue;
+            if(home.size()>=(1u<<28)){ ++epoch; home.clear(); }   // keeps expression keys exact
+            if(i.op==Op::Copy){ set_vn(i.res(), vn_of(i.a1())); continue; }
+            uint32_t x=vn_of(i.a1()), y=vn_of(i.a2());
+            if((i.op==Op::Add || i.op==Op::Mul) && x>y) swap(x,y);
+            uint64_t key=(uint64_t(uint8_t(i.op))<<56) | (uint64_t(x)<<28) | y;
+            auto& e=expr_vn[key];
+            if(e.epoch==epoch){
+                Opnd h=home[e.vn];
+                auto it=opnd_vn.find(okey(h));
+                if(it!=opnd_vn.end() && it->second.epoch==epoch && it->second.vn==e.vn && h!=i.res()){
+                    i=Instr(Op::Copy, h, {}, i.res()); set_vn(i.res(), e.vn); continue;
+                }
+            }
+            uint32_t vn=(uint32_t)home.size(); home.push_back(i.res());
+            e={vn,epoch}; set_vn(i.res(), vn);
+        }
+    }
+}
+
+// Immediate dominators (Cooper/Harvey/Kennedy over reverse postorder) plus pre/post
+// numbers on the dominator tree, so dominates(a,b) is O(1). Unreachable blocks get -1.
+struct Dominators {
+    vector<int> idom, tin, tout;
+    explicit Dominators(const CFG& g){
+        int n=(int)g.blocks.size();
+        vector<int> rpo, order(n,-1), state(n,0);
+        vector<pair<int,size_t>> st{{0,0}}; state[0]=1;
+        while(!st.empty()){
+            auto& [b,k]=st.back();
+            if(k<g.blocks[b].succ.size()){ int s=g.blocks[b].succ[k++]; if(!state[s]){ state[s]=1; st.push_back({s,0}); } }
+            else { rpo.push_back(b); st.pop_back(); }
+        }
+        reverse(rpo.begin(), rpo.end());
+        for(int k=0;k<(int)rpo.size();++k) order[rpo[k]]=k;
+        idom.assign(n,-1); idom[0]=0;
+        auto meet=[&](int a, int b){
+            while(a!=b){ while(order[a]>order[b]) a=idom[a]; while(order[b]>order[a]) b=idom[b]; }
+            return a;
+        };
+        for(bool changed=true; changed; ){
+            changed=false;
+            for(int b: rpo){
+                if(b==0) continue;
+                int d=-1;
+                for(int p: g.blocks[b].pred) if(idom[p]>=0) d= d<0? p: meet(p,d);
+                if(d!=idom[b]){ idom[b]=d; changed=true; }
+            }
+        }
+        vector<vector<int>> kids(n);
+        for(int b=1;b<n;++b) if(idom[b]>=0) kids[idom[b]].push_back(b);
+        tin.assign(n,-1); tout.assign(n,-1);
+        int clock=0; vector<pair<int,size_t>> dfs{{0,0}}; tin[0]=clock++;
+        while(!dfs.empty()){
+            auto& [b,k]=dfs.back();
+            if(k<kids[b].size()){ int c=kids[b][k++]; tin[c]=clock++; dfs.push_back({c,0}); }
+            else { tout[b]=clock++; dfs.pop_back(); }
+        }
+    }
+    bool dominates(int a, int b) const { return tin[a]>=0 && tin[b]>=0 && tin[a]<=tin[b] && tout[b]<=tout[a]; }
+};
+
+// Loop-invariant code motion. Natural loops come from back edges b->h (h dominates b);
+// inside a loop, `tN = a op b` / `tN = a` moves to a preheader just before h's label when
+// tN has a single definition and every operand is an immediate, a variable the loop never
+// writes, or a temp defined outside the loop (or already hoisted). Division only moves
+// with a divisor that cannot trap. The preheader spot is only used when h is entered from
+// outside by fallthrough alone, or h is block 0 and entered only on entry to the code
+// (every `while` chunk under --stream). Each round handles every loop innermost-first on one CFG;
+// further rounds let code hoisted out of an inner loop continue out of the outer one.
+static bool hoist_loop_invariants(TAC& t){
+    if(t.code.empty()) return false;   // the earlier passes can empty a --stream chunk
+    CFG g(t); Dominators dom(g);
+    TempRange R(t);
+    vector<uint32_t> defs(R.size()); vector<int> def_block(R.size(),-1);
+    for(size_t k=0;k<t.code.size();++k){
+        const Instr& i=t.code[k];
+        if(defines(i.op) && i.kr==Arg::Temp){ ++defs[R(i.r)]; def_block[R(i.r)]=g.block_at[k]; }
+    }
+    map<int, vector<int>> latches;   // header -> back edge sources
+    for(int b=0;b<(int)g.blocks.size();++b)
+        for(int h: g.blocks[b].succ) if(dom.dominates(h,b)) latches[h].push_back(b);
+    struct Loop { int header; vector<int> body; };
+    vector<Loop> loops;
+    vector<int> stamp(g.blocks.size(),-1);
+    for(auto& [h,srcs]: latches){
+        int id=(int)loops.size(); Loop L{h,{h}}; stamp[h]=id;
+        vector<int> work(srcs.begin(), srcs.end());
+        while(!work.empty()){
+            int b=work.back(); work.pop_back();
+            if(stamp[b]==id) continue;
+            stamp[b]=id; L.body.push_back(b);
+            for(int p: g.blocks[b].pred) if(stamp[p]!=id) work.push_back(p);
+        }
+        sort(L.body.begin(), L.body.end());
+        loops.push_back(move(L));
+    }
+    stable_sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b){ return a.body.size()<b.body.size(); });
+
+    vector<char> moved(t.code.size()), inloop(g.blocks.size());
+    vector<vector<size_t>> insert_before(t.code.size());
+    vector<char> hoisted(R.size());
+    bool any=false;
+    for(const Loop& L: loops){
+        const BasicBlock& H=g.blocks[L.header];
+        if(t.code[H.begin].op!=Op::Label) continue;
+        for(int b: L.body) inloop[b]=1;
+        bool entry_ok=true; int outside=0;
+        for(int p: H.pred) if(!inloop[p]){
+            ++outside;
+            const Instr& last=t.code[g.blocks[p].end-1];
+            if(p!=L.header-1 || last.op==Op::Goto || last.op==Op::Ifz) entry_ok=false;
+        }
+        unordered_set<int32_t> written;
+        for(int b: L.body) for(size_t k=g.blocks[b].begin;k<g.blocks[b].end;++k)
+            if(defines(t.code[k].op) && t.code[k].kr==Arg::Sym) written.insert(t.code[k].r);
+        auto invariant=[&](Opnd o){
+            switch(o.k){
+                case Arg::Imm:  return true;
+                case Arg::Sym:  return !written.count(o.v);
+                case Arg::Temp: { size_t x=R(o.v); return defs[x]==1 && (hoisted[x] || (def_block[x]>=0 && !inloop[def_block[x]])); }
+                default: return false;
+            }
+        };
+        if(entry_ok && (outside || L.header==0)){
+            for(int b: L.body) for(size_t k=g.blocks[b].begin;k<g.blocks[b].end;++k){
+                const Instr& i=t.code[k];
+                if(moved[k] || !defines(i.op) || i.kr!=Arg::Temp || defs[R(i.r)]!=1) continue;
+                if(!invariant(i.a1()) || (reads_a2(i.op) && !invariant(i.a2()))) continue;
+                if(may_trap(i)) continue;
+                moved[k]=1; hoisted[R(i.r)]=1; insert_before[H.begin].push_back(k); any=true;
+            }
+        }
+        for(int b: L.body) inloop[b]=0;
+    }
+    if(!any) return false;
+    vector<Instr> out; out.reserve(t.code.size());
+    for(size_t k=0;k<t.code.size();++k){
+        for(size_t m: insert_before[k]) out.push_back(t.code[m]);
+        if(!moved[k]) out.push_back(t.code[k]);
+    }
+    t.code.swap(out);
+    return true;
+}
+
+// Last -O1 pass: temps defined once and read only inside their block form trees through
+// their def-use edges, one per expression. Inside a tree a temp takes the lowest number a
+// dead one released (a dying operand can hand its number to the result), so with the
+// Sethi-Ullman order an expression uses BinOp::su names instead of one per node. Numbers
+// never leave their tree, which keeps every name's live range inside one expression for
+// the register allocator; temps that cross blocks (LICM's) keep theirs.
+static void reuse_temps(TAC& t){
+    if(t.code.empty()) return;
+    TempRange R(t); CFG g(t);
+    size_t n=R.size();
+    vector<int> blk(n,-1), last(n,-1), root(n); vector<char> local(n,1), defd(n,0);
+    iota(root.begin(), root.end(), 0);
+    auto find=[&](int x){ while(root[(size_t)x]!=x) x=root[(size_t)x]=root[(size_t)root[(size_t)x]]; return x; };
+    for(size_t k=0;k<t.code.size();++k){
+        const Instr& i=t.code[k];
+        auto see=[&](int v, bool def){
+            size_t x=R(v);
+            if(def){ if(defd[x]) local[x]=0; defd[x]=1; } else if(!defd[x]) local[x]=0;
+            if(blk[x]<0) blk[x]=g.block_at[k]; else if(blk[x]!=g.block_at[k]) local[x]=0;
+            last[x]=(int)k;
+        };
+        if(reads_a1(i.op) && i.ka==Arg::Temp) see(i.a, false);
+        if(reads_a2(i.op) && i.kb==Arg::Temp) see(i.b, false);
+        if(defines(i.op) && i.kr==Arg::Temp) see(i.r, true);
+    }
+    for(const auto& i: t.code) if(defines(i.op) && i.kr==Arg::Temp && local[R(i.r)]){
+        int r=(int)R(i.r);
+        if(reads_a1(i.op) && i.ka==Arg::Temp && local[R(i.a)]) root[(size_t)find((int)R(i.a))]=find(r);
+        if(reads_a2(i.op) && i.kb==Arg::Temp && local[R(i.b)]) root[(size_t)find((int)R(i.b))]=find(r);
+    }
+    vector<int32_t> name(n);
+    vector<vector<int32_t>> freed(n);   // per tree root: released names, lowest at the back
+    auto release=[&](size_t x){
+        auto& f=freed[(size_t)find((int)x)];
+        f.insert(upper_bound(f.begin(), f.end(), name[x], greater<int32_t>()), name[x]);
+    };
+    for(size_t k=0;k<t.code.size();++k){
+        Instr& i=t.code[k];
+        size_t xa=0, xb=0; bool da=false, db=false;
+        if(reads_a1(i.op) && i.ka==Arg::Temp && local[xa=R(i.a)]){ i.a=name[xa]; da=last[xa]==(int)k; }
+        if(reads_a2(i.op) && i.kb==Arg::Temp && local[xb=R(i.b)]){ i.b=name[xb]; db=last[xb]==(int)k; }
+        if(da) release(xa);
+        if(db && !(da && xb==xa)) release(xb);
+        if(defines(i.op) && i.kr==Arg::Temp && local[R(i.r)]){
+            size_t x=R(i.r); auto& f=freed[(size_t)find((int)x)];
+            if(f.empty()) name[x]=i.r; else { name[x]=f.back(); f.pop_back(); }
+            i.r=name[x];
+            if(last[x]==(int)k) release(x);
+        }
+    }
+}
+
+static void optimize(TAC& t){
+    if(t.opt<1 || t.code.empty()) return;
+    if(t.opt>=2){ PhaseTimer ph(Stats::Lvn); local_value_numbering(t, CFG(t)); }
+    { PhaseTimer ph(Stats::CopyProp); copy_propagate(t); }
+    { PhaseTimer ph(Stats::Coalesce); coalesce_copies(t); }
+    { PhaseTimer ph(Stats::DeadTemps); eliminate_dead_temps(t); }
+    if(t.opt>=2){ PhaseTimer ph(Stats::Licm); for(int round=0; round<8 && hoist_loop_invariants(t); ++round) {} }
+    { PhaseTimer ph(Stats::ReuseTemps); reuse_temps(t); }
+}
+
+/*==============================================*
+ * 5) DRIVER: COMPILE → TAC (default behavior)  *
+ *==============================================*/
+struct Options {
+    string path;          // empty => stdin
+    string out;           // --out FILE; empty => stdout
+    bool stream=false;    // --stream
+    int opt=0;            // -O0 / -O1 / -O2
+    int regs=0;           // --regs N: allocatable registers for --asm, 0 = legacy R1 lowering
+    string cache_dir;     // --cache-dir DIR; empty => no TAC cache
+    string incremental;   // --incremental FILE: per-statement reuse state (implies --stream)
+    bool ll1=false;       // --ll1: parse with the generated LL(1) table instead of Parser
+    bool pipeline=false;  // --pipeline: --stream with lexer, parser and codegen on their own threads
+    unsigned parallel=0;  // --parallel [N]: lower top-level statements on N threads (-O0, whole program)
+};
+struct LL1Parser;         // 7b
+
+// --cache-dir: lowered TAC stored as a binary image under a hash of the source bytes and
+// every flag that changes the TAC (-O level, --stream). Layout, all little-endian:
+//   magic "MTAC", version, #names, #chunks, #instrs, #temps, #labels (u32 each)
+//   u64 hash of the body, then the body:
+//   name offsets u32[#names+1], chunk sizes u32[#chunks], Instr[#instrs], name bytes
+// Sym operands hold indices into the name table and are re-interned on load, so an
+// image is independent of the process that wrote it. load() checks the hash and every
+// Instr (opcode, operand kinds for the op, temps/labels/names in range, jumps to a label
+// of the same chunk), so a damaged image is a miss and never reaches a backend. A hit mmaps the image (via Source)
+// and replays the chunks straight into the backend: no Lexer, Parser or gen.
+static atomic<uint64_t> cache_hits{0}, cache_misses{0};
+
+static uint64_t hash_bytes(string_view s, uint64_t h=0x243F6A8885A308D3ull){
+    auto mix=[&](uint64_t w){ h=(h^w)*0x9E3779B97F4A7C15ull; h^=h>>29; };
+    size_t k=0;
+    for(; k+8<=s.size(); k+=8){ uint64_t w; memcpy(&w, s.data()+k, 8); mix(w); }
+    uint64_t tail=0; memcpy(&tail, s.data()+k, s.size()-k); mix(tail); mix(s.size());
+    return h;
+}
+
+struct TACCache {
+    static constexpr uint32_t Version=3;
+    static constexpr size_t Header=4+6*4+8;   // magic, version and counts, then a hash of both counts and body
+    vector<Instr> code; vector<uint32_t> chunks; uint32_t temps=0, labels=0;
+    vector<uint32_t> names;                   // file index -> interned id (save) / id (load)
+    unordered_map<uint32_t, uint32_t> index;  // interned id -> file index
+
+    static string path_for(const string& dir, string_view src, int opt, bool stream){
+        char key[4]={char('0'+opt), char(stream), char(Version), 0};
+        char hex[17]; snprintf(hex, sizeof hex, "%016llx", (unsigned long long)hash_bytes(src, hash_bytes({key, 4})));
+        return dir+"/"+hex+".tacbin";
+    }
+    void add(const TAC& t){
+        auto sym=[&](Arg k, int32_t& v){
+            if(k!=Arg::Sym) return;
+            auto [it, fresh]=index.try_emplace((uint32_t)v, (uint32_t)names.size());
+            if(fresh) names.push_back((uint32_t)v);
+            v=(int32_t)it->second;
+        };
+        auto count=[&](Arg k, int32_t v){
+            if(k==Arg::Temp) temps=max(temps, (uint32_t)v); else if(k==Arg::Label) labels=max(labels, (uint32_t)v);
+        };
+        for(Instr i: t.code){
+            count(i.ka,i.a); count(i.kb,i.b); count(i.kr,i.r);
+            sym(i.ka,i.a); sym(i.kb,i.b); sym(i.kr,i.r); code.push_back(i);
+        }
+        temps=max(temps, (uint32_t)t.tempCounter); labels=max(labels, (uint32_t)t.labelCounter);
+        chunks.push_back((uint32_t)t.code.size());
+    }
+    // Written to a private temp file and renamed, so concurrent jobs never see a torn image.
+    void save(const string& path) const {
+        string tmp=temp_path(path);
+        {
+            string body;
+            auto u32=[](string& s, uint32_t v){ s.append((const char*)&v, 4); };
+            uint32_t off=0; u32(body, off);
+            for(uint32_t id: names){ off+=(uint32_t)interner().name(id).size(); u32(body, off); }
+            for(uint32_t c: chunks) u32(body, c);
+            body.append((const char*)code.data(), code.size()*sizeof(Instr));
+            for(uint32_t id: names) body+=interner().name(id);
+            string head="MTAC";
+            for(uint32_t x: {Version, (uint32_t)names.size(), (uint32_t)chunks.size(), (uint32_t)code.size(), temps, labels}) u32(head, x);
+            uint64_t h=hash_bytes(body, hash_bytes(string_view(head).substr(4))); head.append((const char*)&h, 8);
+            Sink f(tmp);
+            f << head << body;
+            f.close();
+        }
+        if(rename(tmp.c_str(), path.c_str())<0){ unlink(tmp.c_str()); throw runtime_error("Cannot write cache "+path); }
+    }
+    // False when there is no usable image (missing, truncated, other version, damaged).
+    bool load(const string& path){
+        struct stat st{};
+        if(::stat(path.c_str(), &st)<0 || !S_ISREG(st.st_mode)) return false;
+        Source img(path);
+        string_view v=img.view();
+        auto u32=[&](size_t at){ uint32_t x; memcpy(&x, v.data()+at, 4); return x; };
+        if(v.size()<Header || v.substr(0,4)!="MTAC" || u32(4)!=Version) return false;
+        uint64_t nn=u32(8), nc=u32(12), ni=u32(16), h;
+        temps=u32(20); labels=u32(24); memcpy(&h, v.data()+28, 8);
+        if(hash_bytes(v.substr(Header), hash_bytes(v.substr(4, Header-12)))!=h) return false;
+        uint64_t offs=Header, sizes=offs+4*(nn+1), instrs=sizes+4*nc, text=instrs+ni*sizeof(Instr);
+        if(text>v.size() || text+u32(size_t(offs+4*nn))!=v.size()) return false;
+        names.assign(nn, 0);
+        for(uint64_t k=0;k<nn;++k){
+            uint32_t a=u32(size_t(offs+4*k)), b=u32(size_t(offs+4*k+4));
+            if(a>b || text+b>v.size()) return false;
+            names[k]=interner().intern(v.substr(size_t(text+a), b-a));
+        }
+        chunks.resize(nc); uint64_t total=0;
+        for(uint64_t k=0;k<nc;++k) total+=chunks[k]=u32(size_t(sizes+4*k));
+        if(total!=ni) return false;
+        const Instr* p=reinterpret_cast<const Instr*>(v.data()+instrs);
+        code.assign(p, p+ni);
+        if(!well_formed(code, chunks, temps, labels, nn)) return false;
+        auto sym=[&](Arg k, int32_t& x){ if(k==Arg::Sym) x=(int32_t)names[(uint32_t)x]; };
+        for(Instr& i: code){ sym(i.ka,i.a); sym(i.kb,i.b); sym(i.kr,i.r); }
+        return true;
+    }
+    // Every Instr has the shape gen gives its op, temps/labels/names are within 1..temps,
+    // 1..labels and 0..nn-1, and jumps stay inside their chunk. --incremental checks each
+    // of its records with this too.
+    static bool well_formed(const vector<Instr>& code, const vector<uint32_t>& chunks, uint32_t temps, uint32_t labels, uint64_t nn){
+        auto value=[&](Arg k, int32_t x){
+            switch(k){
+                case Arg::Imm:  return true;
+                case Arg::Temp: return x>0 && (uint32_t)x<=temps;
+                case Arg::Sym:  return (uint32_t)x<nn;
+                default:        return false;
+            }
+        };
+        auto label=[&](Arg k, int32_t x){ return k==Arg::Label && x>0 && (uint32_t)x<=labels; };
+        unordered_set<int32_t> here;   // labels placed in the chunk
+        size_t at=0;
+        for(uint32_t n: chunks){
+            here.clear();
+            for(size_t k=at;k<at+n;++k) if(code[k].op==Op::Label) here.insert(code[k].r);
+            for(size_t k=at;k<at+n;++k){
+                const Instr& i=code[k];
+                bool ok;
+                switch(i.op){
+                    case Op::Label: case Op::Goto: ok=i.ka==Arg::None && i.kb==Arg::None && label(i.kr,i.r); break;
+                    case Op::Ifz:   ok=value(i.ka,i.a) && i.kb==Arg::None && label(i.kr,i.r); break;
+                    case Op::Copy:  ok=value(i.ka,i.a) && i.kb==Arg::None && (i.kr==Arg::Temp || i.kr==Arg::Sym) && value(i.kr,i.r); break;
+                    case Op::Print: ok=value(i.ka,i.a) && i.kb==Arg::None && i.kr==Arg::None; break;
+                    case Op::Add: case Op::Sub: case Op::Mul: case Op::Div:
+                        ok=value(i.ka,i.a) && value(i.kb,i.b) && (i.kr==Arg::Temp || i.kr==Arg::Sym) && value(i.kr,i.r); break;
+                    default: ok=false; break;
+                }
+                if(!ok || (i.op!=Op::Label && i.kr==Arg::Label && !here.count(i.r))) return false;
+            }
+            at+=n;
+        }
+        return true;
+    }
+};
+
+// --incremental FILE: TAC reuse across runs at top-level statement granularity. Each
+// statement is keyed by a hash of its source text plus the entry state (declared /
+// initialized / known constant) of every name it mentions, which is everything gen and
+// optimize read. A record keeps the statement's optimized TAC with temps and labels
+// relative to the counters on entry, and the top-level Sym state it leaves behind; a hit
+// shifts the numbering to the current counters and replays the Sym state instead of
+// running gen, so the output is byte-identical to a fresh --stream run.
+// Records are kept in source order. While the input still matches the previous run,
+// the next record's text is checked by hashing the bytes at the cursor, and the Lexer
+// jumps over it without parsing; after an edit the statement is parsed, looked up by
+// key, and the cursor resyncs behind the record found.
+// File: "MINC", version, #names, #records (u32), u64 hash of the rest, names as
+//   (u32 len, bytes), then records
+//   u64 key, text hash; u32 text len, newlines, temps, labels, #names, #effects, #instrs;
+//   u32 names[], Effect[], Instr[]
+// with Sym operands and names as name-table indices. Records are not padded, so load()
+// copies their arrays out of the image, and checks their TAC with TACCache::well_formed
+// (temps and labels relative to the statement). The previous image stays mmap'd and hits
+// are copied forward as raw bytes, since the next file keeps its name table.
+struct IncrementalState {
+    static constexpr uint32_t Version=4;
+    static constexpr uint32_t Declared=1, Initialized=2, Constant=4;
+    struct Effect { uint32_t name; uint32_t flags; int32_t value; };
+    static constexpr size_t Header=4+3*4+8, RecordHeader=16+7*4;
+    struct Record {
+        uint64_t key, text; uint32_t len, newlines, temps, labels;
+        vector<uint32_t> names; vector<Effect> effects; vector<Instr> code;
+        size_t at, bytes;   // the record's raw bytes in the image
+    };
+
+    unique_ptr<Source> img;
+    vector<Record> seq;                       // previous run, in source order
+    unordered_map<uint64_t, size_t> by_key;   // key -> index into seq
+    vector<uint32_t> ids;                     // name index -> interned id
+    unordered_map<uint32_t, uint32_t> index;  // interned id -> name index
+    string body; uint32_t records=0;
+
+    static uint64_t text_hash(string_view text, int opt){ return hash_bytes(text, uint64_t(opt)+1); }
+    static uint32_t state(const Sym* p){ return p? Declared | (p->initialized? Initialized: 0) | (p->constant? Constant: 0): 0; }
+    // `names` are interned ids, in any order.
+    template<class It> static uint64_t key(uint64_t text, It first, It last, SymbolTable& s){
+        vector<pair<string_view, uint64_t>> st;
+        for(; first!=last; ++first){
+            const Sym* p=s.find(*first);
+            st.push_back({interner().name(*first), uint64_t(state(p))<<32 | uint32_t(p && p->constant? p->value: 0)});
+        }
+        sort(st.begin(), st.end());
+        uint64_t h=text;
+        for(const auto& [name, w]: st) h=hash_bytes(string_view((const char*)&w, 8), hash_bytes(name, h));
+        return h;
+    }
+    uint32_t idx(uint32_t id){
+        auto [it, fresh]=index.try_emplace(id, (uint32_t)ids.size());
+        if(fresh) ids.push_back(id);
+        return it->second;
+    }
+    uint32_t id(uint32_t k) const { return k<ids.size()? ids[k]: 0; }
+
+    // A missing, foreign or damaged state file just means nothing is reused.
+    void load(const string& path){
+        struct stat st{};
+        if(::stat(path.c_str(), &st)<0 || !S_ISREG(st.st_mode)) return;
+        img=make_unique<Source>(path);
+        string_view v=img->view(); size_t at=4;
+        auto left=[&]{ return v.size()-at; };
+        auto u32=[&]{ uint32_t x; memcpy(&x, v.data()+at, 4); at+=4; return x; };
+        auto fail=[&]{ seq.clear(); by_key.clear(); ids.clear(); index.clear(); img.reset(); };
+        if(v.size()<Header || v.substr(0,4)!="MINC" || u32()!=Version) return fail();
+        uint32_t nn=u32(), nr=u32(); uint64_t h;
+        memcpy(&h, v.data()+at, 8); at+=8;
+        if(hash_bytes(v.substr(Header), hash_bytes(v.substr(4, Header-12)))!=h) return fail();
+        if(nr>left()/RecordHeader) return fail();
+        for(uint32_t k=0;k<nn;++k){
+            if(left()<4) return fail();
+            uint32_t len=u32();
+            if(left()<len) return fail();
+            idx(interner().intern(v.substr(at, len))); at+=len;
+        }
+        auto array=[&](auto& out, uint32_t n, auto fill){
+            using T=decltype(fill);
+            if(left()/sizeof(T)<n) return false;
+            out.assign(n, fill); memcpy(out.data(), v.data()+at, sizeof(T)*n); at+=sizeof(T)*n;
+            return true;
+        };
+        seq.reserve(nr); by_key.reserve(nr);
+        for(uint32_t k=0;k<nr;++k){
+            Record r;
+            if(left()<RecordHeader) return fail();
+            r.at=at;
+            memcpy(&r.key, v.data()+at, 8); memcpy(&r.text, v.data()+at+8, 8); at+=16;
+            r.len=u32(); r.newlines=u32(); r.temps=u32(); r.labels=u32();
+            uint32_t nnames=u32(), neffects=u32(), ninstrs=u32();
+            if(!array(r.names, nnames, 0u) || !array(r.effects, neffects, Effect{})
+               || !array(r.code, ninstrs, Instr(Op::Label, {}, {}, {}))) return fail();
+            r.bytes=at-r.at;
+            for(uint32_t n: r.names) if(n>=nn) return fail();
+            for(const Effect& f: r.effects) if(f.name>=nn) return fail();
+            if(!TACCache::well_formed(r.code, {ninstrs}, r.temps, r.labels, nn)) return fail();
+            by_key.emplace(r.key, seq.size());
+            seq.push_back(move(r));
+        }
+        if(at!=v.size()) return fail();
+    }
+    uint64_t key_of(const Record& r, SymbolTable& s) const {
+        vector<uint32_t> n(r.names.size());
+        for(size_t k=0;k<n.size();++k) n[k]=id(r.names[k]);
+        return key(r.text, n.begin(), n.end(), s);
+    }
+    // Replays `r` into `t` and the top-level scope, and carries it into the next file.
+    void reuse(const Record& r, TAC& t, SymbolTable& s){
+        for(const Effect& f: r.effects){
+            uint32_t n=id(f.name);
+            if(!n) continue;
+            if(!s.find(n)) s.declare(n, Type::Int);
+            Sym* y=s.find(n);
+            y->initialized=f.flags&Initialized; y->constant=f.flags&Constant; y->value=f.value;
+        }
+        t.code=r.code;
+        for(Instr& i: t.code){
+            auto fix=[&](Arg k, int32_t& v){
+                if(k==Arg::Temp) v+=t.tempCounter; else if(k==Arg::Label) v+=t.labelCounter; else if(k==Arg::Sym) v=(int32_t)id((uint32_t)v);
+            };
+            fix(i.ka,i.a); fix(i.kb,i.b); fix(i.kr,i.r);
+        }
+        t.tempCounter+=(int)r.temps; t.labelCounter+=(int)r.labels;
+        body.append(img->view().substr(r.at, r.bytes));
+        ++records;
+    }
+    // Records a freshly lowered statement: `t` after gen+optimize, counters were t0/l0.
+    void record(uint64_t key, uint64_t text, string_view src, const TAC& t, int t0, int l0, const vector<uint32_t>& names, SymbolTable& s){
+        vector<Effect> eff;
+        for(uint32_t n: names) if(const Sym* p=s.find(n)) eff.push_back({idx(n), state(p), p->value});
+        uint32_t h[7]={(uint32_t)src.size(), (uint32_t)count(src.begin(), src.end(), '\n'), uint32_t(t.tempCounter-t0), uint32_t(t.labelCounter-l0),
+                       (uint32_t)names.size(), (uint32_t)eff.size(), (uint32_t)t.code.size()};
+        body.append((const char*)&key, 8); body.append((const char*)&text, 8); body.append((const char*)h, sizeof h);
+        for(uint32_t n: names){ uint32_t k=idx(n); body.append((const char*)&k, 4); }
+        body.append((const char*)eff.data(), eff.size()*sizeof(Effect));
+        for(Instr i: t.code){
+            auto fix=[&](Arg k, int32_t& v){
+                if(k==Arg::Temp) v-=t0; else if(k==Arg::Label) v-=l0; else if(k==Arg::Sym) v=(int32_t)idx((uint32_t)v);
+            };
+            fix(i.ka,i.a); fix(i.kb,i.b); fix(i.kr,i.r);
+            body.append((const char*)&i, sizeof i);
+        }
+        ++records;
+    }
+    void save(const string& path){
+        string tmp=temp_path(path);
+        {
+            string rest;
+            for(uint32_t k: ids){ string_view n=interner().name(k); uint32_t len=(uint32_t)n.size(); rest.append((const char*)&len, 4); rest+=n; }
+            rest+=body;
+            uint32_t hdr[3]={Version, (uint32_t)ids.size(), records};
+            uint64_t h=hash_bytes(rest, hash_bytes({(const char*)hdr, sizeof hdr}));
+            Sink f(tmp);
+            f << "MINC" << string_view((const char*)hdr, sizeof hdr) << string_view((const char*)&h, 8) << rest;
+            f.close();
+        }
+        if(rename(tmp.c_str(), path.c_str())<0){ unlink(tmp.c_str()); throw runtime_error("Cannot write "+path); }
+    }
+};
+
+// --stream lowering through an IncrementalState loaded from, and written back to,
+// o.incremental. Reports how many statements were reused on stderr.
+// --stats: a token-only pass so lexing gets a time of its own (the parse phase still
+// includes the lexing the parser drives). A lexer error is left for the parser to report,
+// after any parse error ahead of it.
+static void stats_lex(string_view src){
+    PhaseTimer ph(Stats::Lex);
+    Lexer lex(src); uint64_t n=0;
+    try{ while(lex.next().t!=Tok::End) ++n; } catch(const runtime_error&){}
+    stats->tokens+=n;
+}
+// --stats counters only the lowering driver sees, taken once it is done. `nodes` leaves
+// out the program's own Block, which --stream never builds, so every mode agrees.
+static void stats_lowered(size_t nodes, const SymbolTable& sym){
+    if(!stats) return;
+    size_t longest=0, sum=sym.probes(longest);
+    stats->nodes+=nodes; stats->symbols=sym.size(); stats->slots=sym.capacity();
+    stats->max_probe=longest; stats->mean_probe= sym.size()? double(sum)/double(sym.size()): 0;
+}
+
+// A record's text runs up to the token after its statement, so matching it only shows the
+// new source starts the same way. The one token that can carry a statement on past that
+// point is `else` after an `if` without one; then the statement has to be parsed again.
+// A lexer error is left for the parser to report.
+static bool extends_statement(string_view rest){
+    try{ Lexer lx(rest); return lx.next().t==Tok::KwElse; } catch(const runtime_error&){ return false; }
+}
+
+template<class F> static void lower_incremental(const Options& o, string_view src, Sink& out, const char* header, F&& flush){
+    IncrementalState state;
+    state.load(o.incremental);
+    Arena arena;
+    Parser p(src, arena);
+    SymbolTable sym;
+    TAC tac;
+    tac.opt=o.opt;
+    out << header;
+    size_t reused=0, total=0, cursor=0;
+    vector<uint32_t> names;
+    while(!p.at_end()){
+        ++total;
+        const char* from=p.cur.lex.data();
+        size_t left=size_t(src.data()+src.size()-from);
+        if(cursor<state.seq.size()){
+            const auto& r=state.seq[cursor];
+            if(r.len<=left && IncrementalState::text_hash({from, r.len}, o.opt)==r.text && state.key_of(r, sym)==r.key
+               && !extends_statement({from+r.len, left-r.len})){
+                state.reuse(r, tac, sym); ++reused; ++cursor;
+                p.resume_at(from+r.len, (int)r.newlines);
+                flush(tac);
+                tac.code.clear();
+                continue;
+            }
+        }
+        Stmt* st;
+        { PhaseTimer ph(Stats::Parse); st=p.statement(); }
+        const char* to= p.at_end()? src.data()+src.size(): p.cur.lex.data();
+        string_view text(from, size_t(to-from));
+        names.clear(); collect_names(st, names);
+        sort(names.begin(), names.end()); names.erase(unique(names.begin(), names.end()), names.end());
+        uint64_t th=IncrementalState::text_hash(text, o.opt), key=IncrementalState::key(th, names.begin(), names.end(), sym);
+        auto hit=state.by_key.find(key);
+        if(hit!=state.by_key.end()){
+            state.reuse(state.seq[hit->second], tac, sym); ++reused;
+            cursor=hit->second+1;
+        } else {
+            int t0=tac.tempCounter, l0=tac.labelCounter;
+            { PhaseTimer ph(Stats::Gen); gen_stmt(st, tac, sym); }
+            optimize(tac);
+            state.record(key, th, text, tac, t0, l0, names, sym);
+        }
+        flush(tac);
+        tac.code.clear(); arena.reset();
+    }
+    state.save(o.incremental);
+    stats_lowered(arena.nodes, sym);
+    cerr << "incremental: " << reused << " of " << total << " statements reused\n";
+}
+
+// --parallel: the declaration prepass meets every Decl and Assign in the order gen would,
+// so the first Redeclaration/Undeclared is the one sequential lowering reports. Blocks
+// open no scope, so one walk over the global table settles all of them.
+static void resolve_names(Stmt* st, SymbolTable& s){
+    vector<Stmt*> work{st};
+    while(!work.empty()){
+        Stmt* x=work.back(); work.pop_back();
+        switch(x->k){
+            case NK::Decl:   { auto* d=static_cast<Decl*>(x); if(!s.declare(d->name,Type::Int)) throw runtime_error("Redeclaration: "+name_of(d->name)); break; }
+            case NK::Assign: { auto* a=static_cast<Assign*>(x); if(!s.find(a->name)) throw runtime_error("Undeclared: "+name_of(a->name)); break; }
+            case NK::Block:  { auto* b=static_cast<Block*>(x); for(uint32_t k=b->n;k--;) work.push_back(b->ss[k]); break; }
+            case NK::If:     { auto* i=static_cast<IfStmt*>(x); if(i->elseS) work.push_back(i->elseS); work.push_back(i->thenS); break; }
+            case NK::While:  work.push_back(static_cast<WhileStmt*>(x)->body); break;
+            default: break;
+        }
+    }
+}
+// After the prepass, `jobs` threads lower contiguous runs of top-level statements into
+// TACs of their own, temps and labels counted from 1, and stitching shifts each run's
+// numbers by the totals of the runs before it. gen hands numbers out in program order,
+// so the result is the sequential TAC name for name. Only at -O0: from -O1 gen reads the
+// constants earlier statements left in the SymbolTable, which keeps it sequential.
+static void lower_parallel(Block* ast, TAC& tac, SymbolTable& sym, unsigned jobs){
+    for(uint32_t k=0;k<ast->n;++k) resolve_names(ast->ss[k], sym);
+    const size_t runs=min<size_t>(ast->n, size_t(jobs)*8);   // oversplit so a heavy run does not stall the rest
+    vector<TAC> part(runs);
+    auto fan_out=[&](auto&& body){
+        atomic<size_t> next{0}; exception_ptr error; mutex m;
+        auto work=[&, in=active_interner]{
+            active_interner=in;
+            try{ for(size_t r; (r=next++)<runs; ) body(r); }
+            catch(...){ lock_guard<mutex> g(m); if(!error) error=current_exception(); next=runs; }
+        };
+        vector<thread> pool;
+        for(unsigned k=1; k<min<size_t>(jobs, runs); ++k) pool.emplace_back(work);
+        work();
+        for(thread& th: pool) th.join();
+        if(error) rethrow_exception(error);
+    };
+    fan_out([&](size_t r){
+        TAC& t=part[r]; t.opt=tac.opt; t.resolved=true;
+        SymbolTable none;   // consulted only for -O1 constants
+        for(size_t k=ast->n*r/runs, e=ast->n*(r+1)/runs; k<e; ++k) gen_stmt(ast->ss[k], t, none);
+    });
+    vector<int> dt(runs), dl(runs); size_t total=0;
+    for(size_t r=0; r<runs; ++r){
+        dt[r]=tac.tempCounter; dl[r]=tac.labelCounter; total+=part[r].code.size();
+        tac.tempCounter+=part[r].tempCounter; tac.labelCounter+=part[r].labelCounter;
+    }
+    fan_out([&](size_t r){
+        for(Instr& i: part[r].code){
+            auto shift=[&](Arg k, int32_t& v){ if(k==Arg::Temp) v+=dt[r]; else if(k==Arg::Label) v+=dl[r]; };
+            shift(i.ka,i.a); shift(i.kb,i.b); shift(i.kr,i.r);
+        }
+    });
+    tac.code.reserve(tac.code.size()+total);
+    for(TAC& t: part){ tac.code.insert(tac.code.end(), t.code.begin(), t.code.end()); vector<Instr>().swap(t.code); }
+}
+
+// Parses and lowers the program, printing `header` and handing the TAC to `flush`: once
+// at the end, or after every top-level statement under --stream. Streaming recycles the
+// arena and TAC::code per statement, so memory is bounded by the largest statement and
+// output starts right away; temp/label counters and the symbol table carry over.
+template<class P, class F> static void lower_parsed(const Options& o, string_view src, Sink& out, const char* header, F&& flush){
+    if(stats) stats_lex(src);
+    Arena arena;
+    P p(src, arena);
+    SymbolTable sym;
+    TAC tac;
+    tac.opt=o.opt;
+    if(!o.stream){
+        Block* ast;
+        { PhaseTimer ph(Stats::Parse); ast=p.program(); }
+        {
+            PhaseTimer ph(Stats::Gen);
+            if(o.parallel>1 && !o.opt) lower_parallel(ast, tac, sym, o.parallel);
+            else ast->gen(tac, sym);
+        }
+        optimize(tac);
+        out << header;
+        flush(tac);
+        stats_lowered(arena.nodes-1, sym);
+        return;
+    }
+    if(!o.incremental.empty()){ lower_incremental(o, src, out, header, flush); return; }
+    out << header;
+    while(!p.at_end()){
+        Stmt* st;
+        { PhaseTimer ph(Stats::Parse); st=p.statement(); }
+        { PhaseTimer ph(Stats::Gen); gen_stmt(st, tac, sym); }
+        optimize(tac);
+        flush(tac);
+        tac.code.clear(); arena.reset();
+    }
+    stats_lowered(arena.nodes, sym);
+}
+// --pipeline: --stream with its three phases overlapped. A Lexer thread ships token
+// batches to a parser thread, which ships batches of top-level statements, together with
+// the Arena holding them, to the calling thread; that lowers them one at a time exactly
+// like --stream and frees the arena back upstream through a third ring. The first error
+// in program order still wins: a lexer or parse error travels downstream behind every
+// statement before it, and an error in codegen stops the other two stages.
+struct StmtBatch { Arena* arena=nullptr; vector<Stmt*> ss; bool started=false, last=false; exception_ptr error; };
+template<class F> static void lower_pipelined(const Options& o, string_view src, Sink& out, const char* header, F&& flush){
+    static constexpr size_t Arenas=10;   // > the 8 batches in flight plus the one in codegen
+    atomic<bool> stop{false};
+    auto tokens=make_unique<TokenStream::Ring>();
+    auto stmts=make_unique<SpscRing<StmtBatch, 8>>();
+    auto spare=make_unique<SpscRing<Arena*, 16>>();
+    array<Arena, Arenas> arenas;
+    for(Arena& a: arenas){ *spare->producer_slot(stop)=&a; spare->publish(); }
+
+    uint64_t lexed=0; size_t parsed=0;   // written by the lexer and parser threads
+    thread lexer([&, in=active_interner]{
+        active_interner=in;
+        Lexer lex(src);
+        for(bool done=false; !done; ){
+            TokenBatch* b=tokens->producer_slot(stop);
+            if(!b) break;
+            b->n=0; b->failed=false;
+            try{
+                while(b->n<TokenBatch::Cap){ Token t=lex.next(); b->tok[b->n++]=t; if(t.t==Tok::End){ done=true; break; } ++lexed; }
+            } catch(const exception& e){ b->failed=true; b->error=e.what(); done=true; }
+            tokens->publish();
+        }
+    });
+    thread parser([&]{
+        Arena work; vector<Stmt*> ss; bool started=false;   // the first token lexed, as Parser's ctor does
+        auto ship=[&](bool last, exception_ptr error){
+            Arena** a=spare->consumer_slot(stop);
+            if(!a) return;
+            Arena* full=*a; spare->release(); full->swap(work);
+            StmtBatch* b=stmts->producer_slot(stop);
+            if(!b) return;
+            b->arena=full; b->ss.assign(ss.begin(), ss.end()); b->started=started; b->last=last; b->error=error;
+            stmts->publish(); ss.clear();
+        };
+        try{
+            BasicParser<TokenStream> p(TokenStream(*tokens, stop), work);
+            started=true;
+            while(!p.at_end()){
+                ss.push_back(p.statement());
+                if(ss.size()>=64 || work.bytes()>(1u<<20)) ship(false, nullptr);
+            }
+            ship(true, nullptr);
+        } catch(...){ ship(true, current_exception()); }
+        parsed=work.nodes;   // `work` makes every node; the shipped arenas only trade blocks
+    });
+    struct Join {
+        atomic<bool>& stop; thread& a; thread& b;
+        void operator()(){ stop=true; if(a.joinable()) a.join(); if(b.joinable()) b.join(); }
+        ~Join(){ (*this)(); }
+    } join{stop, lexer, parser};
+
+    SymbolTable sym; TAC tac; tac.opt=o.opt;
+    bool headed=false;
+    for(bool last=false; !last; ){
+        StmtBatch* b=stmts->consumer_slot(stop);
+        if(b->started && !headed){ out << header; headed=true; }
+        for(Stmt* st: b->ss){
+            { PhaseTimer ph(Stats::Gen); gen_stmt(st, tac, sym); }
+            optimize(tac);
+            flush(tac);
+            tac.code.clear();
+        }
+        last=b->last; exception_ptr error=b->error; Arena* a=b->arena;
+        stmts->release();
+        if(error) rethrow_exception(error);
+        a->reset(); *spare->producer_slot(stop)=a; spare->publish();
+    }
+    join();   // the workers' counters are only read once they are done
+    if(stats) stats->tokens+=lexed;
+    stats_lowered(parsed, sym);
+}
+
+template<class F> static void lower_source(const Options& o, string_view src, Sink& out, const char* header, F&& flush){
+    if(o.pipeline) lower_pipelined(o, src, out, header, flush);
+    else if(o.ll1) lower_parsed<LL1Parser>(o, src, out, header, flush);
+    else lower_parsed<Parser>(o, src, out, header, flush);
+}
+
+// lower_source() on o.path, through the --cache-dir image when there is one: a hit
+// replays the stored chunks into `flush`, a miss records them and writes the image.
+// Under --stats every chunk handed to the backend is timed as emission and counted.
+template<class F> static void lower_program(const Options& o, Sink& out, const char* header, F&& backend){
+    auto flush=[&](const TAC& tac){
+        PhaseTimer ph(Stats::Emit);
+        backend(tac);
+        if(!stats) return;
+        stats->instrs+=tac.code.size(); stats->bytes=out.bytes();
+        stats->temps=max<uint64_t>(stats->temps, (uint64_t)tac.tempCounter);
+        stats->labels=max<uint64_t>(stats->labels, (uint64_t)tac.labelCounter);
+    };
+    Source src=[&]{ PhaseTimer ph(Stats::Read); return Source(o.path); }();
+    if(o.cache_dir.empty()){ lower_source(o, src.view(), out, header, flush); return; }
+    string cached=TACCache::path_for(o.cache_dir, src.view(), o.opt, o.stream);
+    TACCache rec;
+    if(rec.load(cached)){
+        ++cache_hits;
+        if(stats) stats->replayed=true;
+        out << header;
+        TAC tac; size_t at=0;
+        tac.tempCounter=(int)rec.temps; tac.labelCounter=(int)rec.labels;
+        for(uint32_t n: rec.chunks){
+            tac.code.assign(rec.code.begin()+(ptrdiff_t)at, rec.code.begin()+(ptrdiff_t)(at+n));
+            at+=n; flush(tac);
+        }
+        return;
+    }
+    ++cache_misses;
+    rec=TACCache();
+    lower_source(o, src.view(), out, header, [&](const TAC& tac){ rec.add(tac); flush(tac); });
+    rec.save(cached);
+}
+
+static void compile_to_TAC(const Options& o) {
+    Sink out(o.out);
+    lower_program(o, out, "=== TAC ===\n", [&](const TAC& tac){ tac.dump(out); });
+    out.close();
+}
+
+/*==============================================*
+ * 6) EXTRA: ASSEMBLY CODE GENERATOR (--asm)     *
+ *==============================================*/
+static void dump_asm(const TAC& tac, Sink& os) {
+    static const char* mnem[]={"","","","","","ADD","SUB","MUL","DIV"};
+    for (auto &i : tac.code) {
+        switch (i.op) {
+            case Op::Copy:  os << "MOV " << i.res() << ", " << i.a1() << "\n"; break;
+            case Op::Print: os << "PRINT " << i.a1() << "\n"; break;
+            case Op::Label: os << i.res() << ":\n"; break;
+            case Op::Goto:  os << "JMP " << i.res() << "\n"; break;
+            case Op::Ifz:   os << "CMP " << i.a1() << ", 0\n"; os << "JE " << i.res() << "\n"; break;
+            default: os << "MOV R1, " << i.a1() << "\n" << mnem[(int)i.op] << " R1, " << i.a2() << "\nMOV " << i.res() << ", R1\n"; break;
+        }
+    }
+}
+
+// Live range of every temp as one [first, last] instruction interval: its own defs and
+// uses, widened to block starts/ends wherever block-level liveness has it live-in/out.
+// Only upward-exposed temps (used in a block before being defined there) ever enter the
+// per-block sets, and those are rare, so the sets stay small sorted vectors.
+static vector<pair<int,int>> temp_intervals(const TAC& t, const TempRange& R){
+    vector<pair<int,int>> iv(R.size(), {INT_MAX, INT_MIN});
+    auto touch=[&](size_t x, int k){ iv[x].first=min(iv[x].first,k); iv[x].second=max(iv[x].second,k); };
+    CFG g(t); size_t nb=g.blocks.size();
+    vector<vector<int>> gen(nb), kill(nb), in(nb), out(nb);
+    vector<int> def_in(R.size(),-1), gen_in(R.size(),-1);
+    for(int b=0;b<(int)nb;++b){
+        for(size_t k=g.blocks[b].begin;k<g.blocks[b].end;++k){
+            const Instr& i=t.code[k];
+            auto use=[&](Arg a, int v){
+                if(a!=Arg::Temp) return;
+                int x=(int)R(v); touch(x,(int)k);
+                if(def_in[x]!=b && gen_in[x]!=b){ gen_in[x]=b; gen[b].push_back(x); }
+            };
+            if(reads_a1(i.op)) use(i.ka,i.a);
+            if(reads_a2(i.op)) use(i.kb,i.b);
+            if(defines(i.op) && i.kr==Arg::Temp){
+                int x=(int)R(i.r); touch(x,(int)k);
+                if(def_in[x]!=b){ def_in[x]=b; kill[b].push_back(x); }
+            }
+        }
+        sort(gen[b].begin(), gen[b].end()); sort(kill[b].begin(), kill[b].end());
+        in[b]=gen[b];
+    }
+    vector<int> tmp, next;
+    for(bool changed=true; changed; ){
+        changed=false;
+        for(int b=(int)nb-1;b>=0;--b){
+            out[b].clear();
+            for(int s: g.blocks[b].succ){
+                tmp.clear(); set_union(out[b].begin(), out[b].end(), in[s].begin(), in[s].end(), back_inserter(tmp));
+                out[b].swap(tmp);
+            }
+            tmp.clear(); set_difference(out[b].begin(), out[b].end(), kill[b].begin(), kill[b].end(), back_inserter(tmp));
+            next.clear(); set_union(gen[b].begin(), gen[b].end(), tmp.begin(), tmp.end(), back_inserter(next));
+            if(next!=in[b]){ in[b].swap(next); changed=true; }
+        }
+    }
+    for(size_t b=0;b<nb;++b){
+        for(int x: in[b]) touch(x,(int)g.blocks[b].begin);
+        for(int x: out[b]) touch(x,(int)g.blocks[b].end-1);
+    }
+    return iv;
+}
+
+// Linear-scan allocation of temps onto R1..Rn (Poletto/Sarkar): intervals in start order,
+// the one ending last is spilled when the file is full, and a temp whose last use is the
+// instruction defining another hands its register over so `t3 = t1 + t2` is a plain
+// `ADD R1, R2`. Spilled temps keep a memory slot named after the temp; R0 is scratch.
+struct RegAlloc {
+    TempRange R;
+    vector<uint8_t> reg;    // 1..n, 0 = in memory
+    vector<int> last;       // end of each temp's interval
+    int spills=0, temps=0;
+    RegAlloc(const TAC& t, int nregs): R(t), reg(R.size()), last(R.size()) {
+        auto iv=temp_intervals(t,R);
+        vector<int> order;
+        for(size_t x=0;x<iv.size();++x){ last[x]=iv[x].second; if(iv[x].first!=INT_MAX) order.push_back((int)x); }
+        sort(order.begin(), order.end(), [&](int a, int b){ return iv[a].first<iv[b].first; });
+        temps=(int)order.size();
+        vector<int> active; vector<uint8_t> free_regs;
+        for(int r=nregs;r>=1;--r) free_regs.push_back((uint8_t)r);
+        auto release=[&](size_t k){ free_regs.push_back(reg[active[k]]); active[k]=active.back(); active.pop_back(); };
+        for(int x: order){
+            int start=iv[x].first;
+            for(size_t k=0;k<active.size();) if(last[active[k]]<start) release(k); else ++k;
+            const Instr& i=t.code[start];
+            if(defines(i.op) && i.kr==Arg::Temp && (int)R(i.r)==x && i.op!=Op::Label){
+                auto donor=[&](Arg a, int v){
+                    if(a!=Arg::Temp) return;
+                    int y=(int)R(v);
+                    if(y==x || !reg[y] || last[y]!=start) return;
+                    auto it=find(active.begin(), active.end(), y);
+                    if(it!=active.end()) release(size_t(it-active.begin()));
+                };
+                donor(i.ka,i.a);
+                if(i.op==Op::Add || i.op==Op::Mul) donor(i.kb,i.b);
+            }
+            if(!free_regs.empty()){
+                reg[x]=free_regs.back(); free_regs.pop_back(); active.push_back(x);
+                continue;
+            }
+            ++spills;
+            auto victim=max_element(active.begin(), active.end(), [&](int a, int b){ return last[a]<last[b]; });
+            if(victim!=active.end() && last[*victim]>last[x]){
+                reg[x]=reg[*victim]; reg[*victim]=0; *victim=x;
+            }
+        }
+    }
+    uint8_t at(Opnd o) const { return o.k==Arg::Temp? reg[R(o.v)]: 0; }
+    bool dies(Opnd o, size_t k) const { return o.k==Arg::Temp && last[R(o.v)]==(int)k; }
+};
+
+struct AsmLoc { Opnd o; uint8_t reg; };
+static Sink& operator<<(Sink& s, AsmLoc l){ if(l.reg) return s << 'R' << (int)l.reg; return s << l.o; }
+
+// Same instruction set as dump_asm, but temps sit in the registers RegAlloc gave them and
+// only memory results go through R0 (or through a dying operand's register).
+static void dump_asm(const TAC& tac, const RegAlloc& ra, Sink& os){
+    static const char* mnem[]={"","","","","","ADD","SUB","MUL","DIV"};
+    for(size_t k=0;k<tac.code.size();++k){
+        const Instr& i=tac.code[k];
+        AsmLoc a{i.a1(), ra.at(i.a1())}, b{i.a2(), ra.at(i.a2())}, r{i.res(), ra.at(i.res())};
+        switch(i.op){
+            case Op::Copy:  if(!r.reg || r.reg!=a.reg) os << "MOV " << r << ", " << a << "\n"; break;
+            case Op::Print: os << "PRINT " << a << "\n"; break;
+            case Op::Label: os << i.res() << ":\n"; break;
+            case Op::Goto:  os << "JMP " << i.res() << "\n"; break;
+            case Op::Ifz:   os << "CMP " << a << ", 0\n" << "JE " << i.res() << "\n"; break;
+            default: {
+                const char* m=mnem[(int)i.op];
+                bool comm=i.op==Op::Add || i.op==Op::Mul;
+                if(r.reg && a.reg==r.reg) os << m << ' ' << r << ", " << b << "\n";
+                else if(r.reg && b.reg==r.reg && comm) os << m << ' ' << r << ", " << a << "\n";
+                else if(r.reg && b.reg!=r.reg) os << "MOV " << r << ", " << a << "\n" << m << ' ' << r << ", " << b << "\n";
+                else if(!r.reg && a.reg && ra.dies(a.o,k)) os << m << ' ' << a << ", " << b << "\nMOV " << r << ", " << a << "\n";
+                else os << "MOV R0, " << a << "\n" << m << " R0, " << b << "\nMOV " << r << ", R0\n";
+            }
+        }
+    }
+}
+
+static void generate_assembly_from_TAC(const Options& o) {
+    Sink out(o.out);
+    int spills=0, temps=0;
+    lower_program(o, out, "=== PSEUDO ASSEMBLY CODE ===\n", [&](const TAC& tac){
+        if(!o.regs){ dump_asm(tac, out); return; }
+        RegAlloc ra(tac, o.regs);
+        dump_asm(tac, ra, out);
+        spills+=ra.spills; temps+=ra.temps;
+    });
+    if(o.regs) out << "; program: " << temps << " temps in R1..R" << o.regs << ", " << spills << " spilled\n";
+    out.close();
+}
+
+/*=========================================*
+ * 6a) NATIVE x86-64 BACKEND (--x86-64)    *
+ *=========================================*/
+// GNU as (AT&T) output for Linux x86-64, freestanding: `_start` runs the program, then
+// flushes and exits through syscalls, so `as prog.s -o prog.o && ld prog.o -o prog` is
+// the whole toolchain. Values are 32-bit like the TAC; temps go through RegAlloc onto
+// the registers below, %eax is scratch, %ecx/%edx are reserved for idiv. Variables and
+// spilled temps live in .bss as v_<name> / t_<n>.
+static const char* const X86_REGS[]={"%ebx","%esi","%edi","%r8d","%r9d","%r10d","%r11d","%r12d","%r13d","%r14d","%r15d"};
+static constexpr int X86_NREGS=int(sizeof X86_REGS/sizeof *X86_REGS);
+
+static const char X86_RUNTIME[]=R"(    call    mini_flush
+    movl    $60, %eax
+    xorl    %edi, %edi
+    syscall
+
+# division by zero: flush what was printed, report like the compiler does, exit 1
+mini_div0:
+    call    mini_flush
+    movl    $1, %eax
+    movl    $2, %edi
+    leaq    mini_div0_msg(%rip), %rsi
+    movl    $24, %edx
+    syscall
+    movl    $60, %eax
+    movl    $1, %edi
+    syscall
+
+# print %eax as a decimal line into mini_buf; preserves every register
+mini_print:
+    pushq   %rcx
+    pushq   %rdx
+    pushq   %rsi
+    pushq   %rdi
+    pushq   %r8
+    movl    %eax, %r8d
+    cmpl    $65500, mini_len(%rip)
+    jb      1f
+    call    mini_flush
+1:  movl    mini_len(%rip), %esi
+    leaq    mini_buf(%rip), %rdi
+    addq    %rdi, %rsi
+    testl   %eax, %eax
+    jns     2f
+    movb    $45, (%rsi)
+    incq    %rsi
+    negl    %eax
+2:  leaq    mini_tmp+16(%rip), %rdi
+    movl    $10, %ecx
+3:  xorl    %edx, %edx
+    divl    %ecx
+    addb    $48, %dl
+    decq    %rdi
+    movb    %dl, (%rdi)
+    testl   %eax, %eax
+    jnz     3b
+    leaq    mini_tmp+16(%rip), %rcx
+4:  movb    (%rdi), %dl
+    movb    %dl, (%rsi)
+    incq    %rdi
+    incq    %rsi
+    cmpq    %rcx, %rdi
+    jb      4b
+    movb    $10, (%rsi)
+    incq    %rsi
+    leaq    mini_buf(%rip), %rdi
+    subq    %rdi, %rsi
+    movl    %esi, mini_len(%rip)
+    movl    %r8d, %eax
+    popq    %r8
+    popq    %rdi
+    popq    %rsi
+    popq    %rdx
+    popq    %rcx
+    ret
+
+# write(1, mini_buf, mini_len) until done; preserves every register
+mini_flush:
+    pushq   %rax
+    pushq   %rcx
+    pushq   %rdx
+    pushq   %rsi
+    pushq   %rdi
+    pushq   %r11
+    leaq    mini_buf(%rip), %rsi
+    movl    mini_len(%rip), %edx
+1:  testl   %edx, %edx
+    jz      2f
+    movl    $1, %eax
+    movl    $1, %edi
+    syscall
+    testq   %rax, %rax
+    jle     2f
+    addq    %rax, %rsi
+    subl    %eax, %edx
+    jmp     1b
+2:  movl    $0, mini_len(%rip)
+    popq    %r11
+    popq    %rdi
+    popq    %rsi
+    popq    %rdx
+    popq    %rcx
+    popq    %rax
+    ret
+
+mini_div0_msg:
+    .ascii  "Error: Division by zero\n"
+
+    .bss
+    .p2align 4
+mini_buf:   .zero 65536
+mini_tmp:   .zero 16
+mini_len:   .zero 4
+)";
+
+// Location of an operand: RegAlloc's register 1..X86_NREGS, one of the two scratch
+// registers below, or (reg 0) an immediate / memory slot named by the Opnd.
+struct X86Loc { Opnd o; uint8_t reg; };
+static constexpr uint8_t X86_EAX=X86_NREGS+1, X86_ECX=X86_NREGS+2;
+
+// Labels below zero are the emitter's own: X86_DIV0 is its division-by-zero stub, the
+// rest are numbered down from there by lower_x86 and never clash with TAC labels.
+static constexpr int32_t X86_DIV0=-1;
+
+// The TAC -> x86-64 instruction selection, shared by the text backend and the JIT: E is
+// an emitter with label/jmp/je/jne/cmpi/mov/alu/neg/cltd/idiv/print. Destinations of alu
+// are always registers and mov never gets two memory operands.
+template<class E> static void lower_x86(const TAC& tac, const RegAlloc& ra, E& e){
+    const X86Loc eax{{}, X86_EAX}, ecx{{}, X86_ECX};
+    int32_t& local=e.local;
+    auto at=[&](Opnd o){ return X86Loc{o, ra.at(o)}; };
+    auto mem=[](X86Loc l){ return !l.reg && l.o.k!=Arg::Imm; };
+    for(const Instr& i: tac.code){
+        X86Loc a=at(i.a1()), b=at(i.a2()), r=at(i.res());
+        switch(i.op){
+            case Op::Label: e.label(i.r); break;
+            case Op::Goto:  e.jmp(i.r); break;
+            case Op::Ifz:
+                if(a.o.k==Arg::Imm){ if(!a.o.v) e.jmp(i.r); break; }
+                e.cmpi(a, 0); e.je(i.r); break;
+            case Op::Print: e.mov(eax, a); e.print(); break;
+            case Op::Copy:
+                if(r.reg && r.reg==a.reg) break;
+                if(mem(r) && mem(a)){ e.mov(eax, a); e.mov(r, eax); }
+                else e.mov(r, a);
+                break;
+            case Op::Div:
+                // idivl faults on x/0 and INT_MIN/-1; like the bytecode, x/0 is an error
+                // and x/-1 is a wrapping negation.
+                e.mov(eax, a);
+                if(b.o.k==Arg::Imm){
+                    if(b.o.v==0) e.jmp(X86_DIV0);
+                    else if(b.o.v==-1) e.neg(eax);
+                    else { e.cltd(); e.mov(ecx, b); e.idiv(ecx); }
+                }
+                else {
+                    int32_t plain=--local, done=--local;
+                    e.cmpi(b, 0); e.je(X86_DIV0);
+                    e.cmpi(b, -1); e.jne(plain);
+                    e.neg(eax); e.jmp(done);
+                    e.label(plain); e.cltd(); e.idiv(b);
+                    e.label(done);
+                }
+                e.mov(r, eax);
+                break;
+            default: {
+                bool comm=i.op!=Op::Sub;
+                if(r.reg && a.reg==r.reg) e.alu(i.op, r, b);
+                else if(r.reg && b.reg==r.reg && comm) e.alu(i.op, r, a);
+                else if(r.reg && b.reg!=r.reg){ e.mov(r, a); e.alu(i.op, r, b); }
+                else { e.mov(eax, a); e.alu(i.op, eax, b); e.mov(r, eax); }
             }
-            return {Tok::Id,id,L,C};
         }
-        get();
-        switch(c){
-            case '+': return {Tok::Plus,"+",L,C};
-            case '-': return {Tok::Minus,"-",L,C};
-            case '*': return {Tok::Mul,"*",L,C};
-            case '/': return {Tok::Div,"/",L,C};
-            case '=': return {Tok::Assign,"=",L,C};
-            case '(': return {Tok::LParen,"(",L,C};
-            case ')': return {Tok::RParen,")",L,C};
-            case '{': return {Tok::LBrace,"{",L,C};
-            case '}': return {Tok::RBrace,"}",L,C};
-            case ';': return {Tok::Semicolon,";",L,C};
-        }
-        throw runtime_error("Unknown character at "+to_string(L)+":"+to_string(C));
     }
-};
+}
 
-/*===============================================*
- * 2) HASH-BASED SYMBOL TABLE (SEPARATE CHAINING) *
- *===============================================*/
-struct Sym { string name; string type; int value=0; bool initialized=false; };
-struct SymbolTable {
-    vector<vector<Sym>> buckets;
-    explicit SymbolTable(size_t sz=257): buckets(sz) {}
-    size_t idx(const string& k) const { return std::hash<string>{}(k) % buckets.size(); }
-    bool declare(const string& name, const string& type){
-        auto &b = buckets[idx(name)];
-        for(auto &e: b) if(e.name==name) return false;
-        b.push_back({name,type,0,false}); return true;
+// GNU as text. Variables and spilled temps it names are collected so .bss can be laid
+// out once every chunk has been seen.
+struct X86Text {
+    Sink& os;
+    set<uint32_t> vars; set<int32_t> slots;
+    int32_t local=X86_DIV0;
+    Sink& put(X86Loc l){
+        if(l.reg==X86_EAX) return os << "%eax";
+        if(l.reg==X86_ECX) return os << "%ecx";
+        if(l.reg) return os << X86_REGS[l.reg-1];
+        switch(l.o.k){
+            case Arg::Imm:  return os << '$' << l.o.v;
+            case Arg::Sym:  vars.insert((uint32_t)l.o.v); return os << "v_" << interner().name((uint32_t)l.o.v) << "(%rip)";
+            case Arg::Temp: slots.insert(l.o.v); return os << "t_" << l.o.v << "(%rip)";
+            default:        return os;
+        }
     }
-    Sym* find(const string& name){
-        auto &b = buckets[idx(name)];
-        for(auto &e: b) if(e.name==name) return &e;
-        return nullptr;
+    Sink& name(int n){ return n==X86_DIV0? os << "mini_div0": n<0? os << ".Lx" << -n: os << ".L" << n; }
+    void label(int n){ name(n) << ":\n"; }
+    void jmp(int n){ os << "    jmp     "; name(n) << "\n"; }
+    void je(int n){ os << "    je      "; name(n) << "\n"; }
+    void jne(int n){ os << "    jne     "; name(n) << "\n"; }
+    void cmpi(X86Loc a, int8_t v){ os << "    cmpl    $" << int(v) << ", "; put(a) << "\n"; }
+    void mov(X86Loc d, X86Loc s){ os << "    movl    "; put(s) << ", "; put(d) << "\n"; }
+    void alu(Op op, X86Loc d, X86Loc s){
+        os << "    " << (op==Op::Add? "addl": op==Op::Sub? "subl": "imull") << "    "; put(s) << ", "; put(d) << "\n";
     }
+    void neg(X86Loc d){ os << "    negl    "; put(d) << "\n"; }
+    void cltd(){ os << "    cltd\n"; }
+    void idiv(X86Loc s){ os << "    idivl   "; put(s) << "\n"; }
+    void print(){ os << "    call    mini_print\n"; }
 };
 
-/*=============================*
- * 3) AST NODES & TAC EMITTER  *
- *=============================*/
-struct Instr{ string op,a1,a2,res; };
-struct TAC {
-    vector<Instr> code; int tempCounter=0, labelCounter=0;
-    string newTemp(){ return "t"+to_string(++tempCounter); }
-    string newLabel(const string& base="L"){ return base+to_string(++labelCounter); }
-    void emit(const string& op,const string& a1="",const string& a2="",const string& res=""){ code.push_back({op,a1,a2,res}); }
-    void dump(ostream& os=cout) const {
-        for(auto &i: code){
-            if(i.op=="label") os<<i.res<<":\n";
-            else if(i.op=="goto") os<<"    goto "<<i.res<<"\n";
-            else if(i.op=="ifz") os<<"    ifz "<<i.a1<<" goto "<<i.res<<"\n";
-            else if(i.op=="=")  os<<"    "<<i.res<<" = "<<i.a1<<"\n";
-            else if(i.op=="print") os<<"    print "<<i.a1<<"\n";
-            else if(!i.a2.empty()) os<<"    "<<i.res<<" = "<<i.a1<<" "<<i.op<<" "<<i.a2<<"\n";
-        }
-    }
-};
+static void generate_x86_64(const Options& o){
+    Sink out(o.out);
+    X86Text e{out, {}, {}};
+    lower_program(o, out, "    .text\n    .globl  _start\n_start:\n", [&](const TAC& tac){
+        RegAlloc ra(tac, X86_NREGS);
+        lower_x86(tac, ra, e);
+    });
+    out << X86_RUNTIME << "    .p2align 2\n";
+    for(uint32_t v: e.vars) out << "v_" << interner().name(v) << ": .zero 4\n";
+    for(int32_t t: e.slots) out << "t_" << t << ": .zero 4\n";
+    out.close();
+}
 
-struct Node{ virtual ~Node(){} virtual string gen(TAC&, SymbolTable&)=0; };
-struct Expr: Node{};
-struct Num: Expr{
-    int v; explicit Num(int v):v(v){}
-    string gen(TAC& t, SymbolTable&) override{
-        string tmp=t.newTemp(); t.emit("=",to_string(v),"",tmp); return tmp;
-    }
-};
-struct Var: Expr{
-    string name; explicit Var(string n):name(move(n)){}
-    string gen(TAC& t, SymbolTable&) override{
-        string tmp=t.newTemp(); t.emit("=",name,"",tmp); return tmp;
-    }
-};
-struct BinOp: Expr{
-    string op; unique_ptr<Expr> a,b;
-    BinOp(string op, unique_ptr<Expr> a, unique_ptr<Expr> b)
-        :op(move(op)),a(move(a)),b(move(b)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        string x=a->gen(t,s), y=b->gen(t,s), z=t.newTemp(); t.emit(op,x,y,z); return z;
+// --run-jit: the same instruction selection encoded straight into machine code, run from
+// an mmap'd buffer (written RW, flipped to RX before the call, W^X throughout). The code
+// is `int(int32_t* slots)`: %rbp holds `slots`, where every variable and spilled temp
+// gets a 4-byte cell on first use. print calls back into the host with the value. A
+// division by zero jumps to a stub that returns 1 through the normal epilogue, and the
+// host throws the same error the bytecode interpreter does. Nothing may unwind through
+// the generated frames, so the callback returns nonzero instead of throwing and the code
+// returns 2 the same way.
+struct X86Jit {
+    vector<uint8_t> c;
+    unordered_map<uint64_t, int32_t> slot;   // (Arg, v) -> cell index; kept across chunks
+    vector<int32_t> cells;
+    unordered_map<int32_t, size_t> labels; vector<pair<size_t, int32_t>> fixups;
+    int32_t local=X86_DIV0;
+    static constexpr int32_t Stopped=INT32_MIN;   // label of the stub for a failed print
+    int (*print_cb)(void*, int32_t); void* ctx;
+
+    static int phys(uint8_t r){ static const int P[]={0,3,6,7,8,9,10,11,12,13,14,15,0,1}; return P[r]; }
+    void put(initializer_list<int> bytes){ for(int x: bytes) c.push_back((uint8_t)x); }
+    void d32(int32_t v){ uint8_t b[4]; memcpy(b,&v,4); c.insert(c.end(), b, b+4); }
+    void d64(const void* p){ uint8_t b[8]; uint64_t v=(uint64_t)(uintptr_t)p; memcpy(b,&v,8); c.insert(c.end(), b, b+8); }
+    int32_t cell(Opnd o){
+        auto [it, fresh]=slot.try_emplace((uint64_t(uint8_t(o.k))<<32) | uint32_t(o.v), (int32_t)cells.size());
+        if(fresh) cells.push_back(0);
+        return it->second*4;
     }
-};
-struct Stmt: Node{};
-struct Decl: Stmt{
-    string name; unique_ptr<Expr> init;
-    Decl(string n, unique_ptr<Expr> e):name(move(n)),init(move(e)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        if(!s.declare(name,"int")) throw runtime_error("Redeclaration: "+name);
-        if(init){ string v=init->gen(t,s); t.emit("=",v,"",name); auto *p=s.find(name); if(p){p->initialized=true;} }
-        return "";
+    // opcode + ModRM with `reg` in the reg field and `m` (register or [rbp+disp32]) as r/m
+    void rm(initializer_list<int> op, int reg, X86Loc m){
+        int rex=0x40 | (reg>=8? 4: 0) | (m.reg && phys(m.reg)>=8? 1: 0);
+        if(rex!=0x40) c.push_back((uint8_t)rex);
+        put(op);
+        if(m.reg) c.push_back(uint8_t(0xC0 | (reg&7)<<3 | (phys(m.reg)&7)));
+        else { c.push_back(uint8_t(0x85 | (reg&7)<<3)); d32(cell(m.o)); }
     }
-};
-struct Assign: Stmt{
-    string name; unique_ptr<Expr> rhs;
-    Assign(string n, unique_ptr<Expr> e):name(move(n)),rhs(move(e)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        if(!s.find(name)) throw runtime_error("Undeclared: "+name);
-        string v=rhs->gen(t,s); t.emit("=",v,"",name); s.find(name)->initialized=true; return "";
+    void jump(initializer_list<int> op, int n){ put(op); fixups.push_back({c.size(), n}); d32(0); }
+
+    void label(int n){ labels[n]=c.size(); }
+    void jmp(int n){ jump({0xE9}, n); }
+    void je(int n){ jump({0x0F,0x84}, n); }
+    void jne(int n){ jump({0x0F,0x85}, n); }
+    void cmpi(X86Loc a, int8_t v){ rm({0x83}, 7, a); c.push_back((uint8_t)v); }
+    void mov(X86Loc d, X86Loc s){
+        if(!s.reg && s.o.k==Arg::Imm){
+            if(d.reg){ int p=phys(d.reg); if(p>=8) c.push_back(0x41); c.push_back(uint8_t(0xB8+(p&7))); }
+            else rm({0xC7}, 0, d);
+            d32(s.o.v);
+        }
+        else if(d.reg) rm({0x8B}, phys(d.reg), s);
+        else rm({0x89}, phys(s.reg), d);
     }
-};
-struct Print: Stmt{
-    unique_ptr<Expr> e; explicit Print(unique_ptr<Expr> e):e(move(e)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        string v=e->gen(t,s); t.emit("print",v); return "";
+    void alu(Op op, X86Loc d, X86Loc s){
+        if(!s.reg && s.o.k==Arg::Imm){
+            if(op==Op::Mul) rm({0x69}, phys(d.reg), d); else rm({0x81}, op==Op::Add? 0: 5, d);
+            d32(s.o.v);
+        }
+        else if(op==Op::Mul) rm({0x0F,0xAF}, phys(d.reg), s);
+        else rm({op==Op::Add? 0x03: 0x2B}, phys(d.reg), s);
     }
-};
-struct Block: Stmt{
-    vector<unique_ptr<Stmt>> ss;
-    string gen(TAC& t, SymbolTable& s) override{ for(auto &st: ss) st->gen(t,s); return ""; }
-};
-struct IfStmt: Stmt{
-    unique_ptr<Expr> cond; unique_ptr<Stmt> thenS; unique_ptr<Stmt> elseS;
-    IfStmt(unique_ptr<Expr> c, unique_ptr<Stmt> t, unique_ptr<Stmt> e=nullptr)
-        :cond(move(c)),thenS(move(t)),elseS(move(e)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        string c=cond->gen(t,s); string Lelse=t.newLabel("L"), Lend=t.newLabel("L");
-        if(elseS){ t.emit("ifz",c,"",Lelse); thenS->gen(t,s); t.emit("goto","","",Lend); t.emit("label","","",Lelse); elseS->gen(t,s); t.emit("label","","",Lend); }
-        else     { t.emit("ifz",c,"",Lend);  thenS->gen(t,s); t.emit("label","","",Lend); }
-        return "";
+    void neg(X86Loc d){ rm({0xF7}, 3, d); }
+    void cltd(){ c.push_back(0x99); }
+    void idiv(X86Loc s){ rm({0xF7}, 7, s); }
+    // The allocatable caller-saved registers (esi, edi, r8d-r11d) are saved around the call;
+    // six pushes keep the 16-byte alignment the prologue set up.
+    void print(){
+        put({0x56, 0x57, 0x41,0x50, 0x41,0x51, 0x41,0x52, 0x41,0x53});
+        put({0x89,0xC6});                    // mov  %eax, %esi
+        put({0x48,0xBF}); d64(ctx);          // movabs ctx, %rdi
+        put({0x48,0xB8}); d64((const void*)print_cb);   // movabs cb, %rax
+        put({0xFF,0xD0});                    // call *%rax
+        put({0x41,0x5B, 0x41,0x5A, 0x41,0x59, 0x41,0x58, 0x5F, 0x5E});
+        put({0x85,0xC0}); jne(Stopped);      // test %eax,%eax
     }
-};
-struct WhileStmt: Stmt{
-    unique_ptr<Expr> cond; unique_ptr<Stmt> body;
-    WhileStmt(unique_ptr<Expr> c, unique_ptr<Stmt> b):cond(move(c)),body(move(b)){}
-    string gen(TAC& t, SymbolTable& s) override{
-        string Lb=t.newLabel("L"), Lend=t.newLabel("L");
-        t.emit("label","","",Lb);
-        string c=cond->gen(t,s); t.emit("ifz",c,"",Lend);
-        body->gen(t,s);
-        t.emit("goto","","",Lb);
-        t.emit("label","","",Lend);
-        return "";
+
+    // False when the print callback stopped the code.
+    bool run(const TAC& tac, const RegAlloc& ra){
+        c.clear(); labels.clear(); fixups.clear();
+        put({0x53, 0x55, 0x41,0x54, 0x41,0x55, 0x41,0x56, 0x41,0x57});   // push rbx rbp r12-r15
+        put({0x48,0x83,0xEC,0x08, 0x48,0x89,0xFD});                     // sub $8,%rsp; mov %rdi,%rbp
+        lower_x86(tac, ra, *this);
+        const int32_t epilogue=--local;
+        put({0x31,0xC0});                                               // xor %eax,%eax
+        label(epilogue);
+        put({0x48,0x83,0xC4,0x08, 0x41,0x5F, 0x41,0x5E, 0x41,0x5D, 0x41,0x5C, 0x5D, 0x5B, 0xC3});
+        label(X86_DIV0);
+        put({0xB8,1,0,0,0}); jmp(epilogue);                             // mov $1,%eax
+        label(Stopped);
+        put({0xB8,2,0,0,0}); jmp(epilogue);                             // mov $2,%eax
+        for(auto [at, n]: fixups){
+            auto it=labels.find(n);
+            if(it==labels.end()) throw logic_error("JIT: jump to undefined label");
+            int32_t rel=int32_t(it->second-(at+4)); memcpy(&c[at], &rel, 4);
+        }
+        size_t len=(c.size()+4095)&~size_t(4095);
+        void* mem=mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(mem==MAP_FAILED) throw runtime_error("JIT: cannot map code buffer");
+        memcpy(mem, c.data(), c.size());
+        if(mprotect(mem, len, PROT_READ|PROT_EXEC)<0){ munmap(mem, len); throw runtime_error("JIT: cannot make code executable"); }
+        int rc=reinterpret_cast<int(*)(int32_t*)>(mem)(cells.data());
+        munmap(mem, len);
+        if(rc==1) throw runtime_error("Division by zero");
+        return rc==0;
     }
 };
 
-/*=============================*
- * 4) RECURSIVE-DESCENT PARSER *
- *=============================*/
-struct Parser {
-    Lexer lex; Token cur;
-    explicit Parser(const string& src): lex(src) { cur=lex.next(); }
-    [[noreturn]] void err(const string& m){ throw runtime_error(m+" at line "+to_string(cur.line)); }
-    void eat(Tok t){ if(cur.t==t) cur=lex.next(); else err("Unexpected token: "+cur.lex); }
-    bool accept(Tok t){ if(cur.t==t){ cur=lex.next(); return true;} return false; }
+static void run_jit(const Options& o){
+#if defined(__x86_64__)
+    Sink out(o.out);
+    struct Printer { Sink& out; exception_ptr error; } printer{out, nullptr};
+    X86Jit jit;
+    jit.ctx=&printer;
+    jit.print_cb=[](void* c, int32_t v){
+        auto* p=static_cast<Printer*>(c);
+        try{ p->out << v << '\n'; return 0; }
+        catch(...){ p->error=current_exception(); return 1; }
+    };
+    lower_program(o, out, "", [&](const TAC& tac){
+        RegAlloc ra(tac, X86_NREGS);
+        if(!jit.run(tac, ra)) rethrow_exception(printer.error);
+    });
+    out.close();
+#else
+    (void)o; throw runtime_error("--run-jit needs an x86-64 host");
+#endif
+}
 
-    unique_ptr<Expr> factor(){
-        if(cur.t==Tok::Num){ int v=stoi(cur.lex); eat(Tok::Num); return make_unique<Num>(v); }
-        if(cur.t==Tok::Id){ string n=cur.lex; eat(Tok::Id); return make_unique<Var>(n); }
-        if(cur.t==Tok::LParen){ eat(Tok::LParen); auto e=expr(); eat(Tok::RParen); return e; }
-        err("Expected factor"); return nullptr;
-    }
-    unique_ptr<Expr> term(){
-        auto e=factor();
-        while(cur.t==Tok::Mul || cur.t==Tok::Div){
-            string op=(cur.t==Tok::Mul?"*":"/"); eat(cur.t);
-            e=make_unique<BinOp>(op, move(e), factor());
+/*===============================================*
+ * 6b) BATCH COMPILATION (--batch, --batch-list) *
+ *===============================================*/
+// Runs job(0..n-1) on `threads` workers. Each worker starts with a contiguous slice in its
+// own deque and pops from the front; once that is empty it steals from the back of the
+// others. Jobs are whole files, so one mutex per deque is plenty.
+template<class F> static void run_work_stealing(size_t n, unsigned threads, F&& job){
+    threads=(unsigned)max<size_t>(1, min<size_t>(threads, n));
+    struct Queue { mutex m; deque<size_t> q; };
+    vector<Queue> qs(threads);
+    for(unsigned w=0; w<threads; ++w)
+        for(size_t k=n*w/threads; k<n*(w+1)/threads; ++k) qs[w].q.push_back(k);
+    auto worker=[&](unsigned w){
+        for(;;){
+            size_t k=SIZE_MAX;
+            { lock_guard<mutex> g(qs[w].m); if(!qs[w].q.empty()){ k=qs[w].q.front(); qs[w].q.pop_front(); } }
+            for(unsigned v=1; k==SIZE_MAX && v<threads; ++v){
+                Queue& victim=qs[(w+v)%threads];
+                lock_guard<mutex> g(victim.m);
+                if(!victim.q.empty()){ k=victim.q.back(); victim.q.pop_back(); }
+            }
+            if(k==SIZE_MAX) return;   // the job set is fixed, so empty everywhere means done
+            job(k);
         }
-        return e;
+    };
+    vector<thread> pool;
+    for(unsigned w=1; w<threads; ++w) pool.emplace_back(worker, w);
+    worker(0);
+    for(auto& t: pool) t.join();
+}
+
+// prog.src -> prog.tac / prog.asm, next to the input or inside `dir`.
+static string batch_output_path(const string& in, const string& dir, const string& mode){
+    size_t slash=in.find_last_of('/');
+    string base=dir.empty()? in: dir+"/"+(slash==string::npos? in: in.substr(slash+1));
+    size_t dot=base.find_last_of('.'); slash=base.find_last_of('/');
+    if(dot!=string::npos && (slash==string::npos || dot>slash)) base.resize(dot);
+    return base+(mode=="--asm"? ".asm": mode=="--x86-64"? ".s": ".tac");
+}
+
+// Every input gets its own Source/Parser/SymbolTable/TAC and interner; errors are reported
+// in input order once all jobs finish, so the result does not depend on scheduling.
+static int compile_batch(const Options& o, const vector<string>& inputs, unsigned jobs, const string& mode){
+    vector<string> outs(inputs.size()), errors(inputs.size());
+    unordered_set<string> seen;
+    for(size_t k=0;k<inputs.size();++k){
+        outs[k]=batch_output_path(inputs[k], o.out, mode);
+        if(outs[k]==inputs[k]) throw runtime_error("Batch output would overwrite its input: "+inputs[k]);
+        if(!seen.insert(outs[k]).second) throw runtime_error("Two batch inputs map to "+outs[k]);
     }
-    unique_ptr<Expr> expr(){
-        auto e=term();
-        while(cur.t==Tok::Plus || cur.t==Tok::Minus){
-            string op=(cur.t==Tok::Plus?"+":"-"); eat(cur.t);
-            e=make_unique<BinOp>(op, move(e), term());
+    run_work_stealing(inputs.size(), jobs, [&](size_t k){
+        InternerScope scope;
+        Options f=o; f.path=inputs[k]; f.out=outs[k];
+        try{
+            if(mode=="--asm") generate_assembly_from_TAC(f);
+            else if(mode=="--x86-64") generate_x86_64(f);
+            else compile_to_TAC(f);
         }
-        return e;
-    }
+        catch(const exception& e){ errors[k]=e.what(); }
+    });
+    int failed=0;
+    for(size_t k=0;k<inputs.size();++k)
+        if(!errors[k].empty()){ cerr << inputs[k] << ": Error: " << errors[k] << "\n"; ++failed; }
+    return failed? 1: 0;
+}
 
-    unique_ptr<Stmt> statement(){
-        if(cur.t==Tok::KwInt){
-            eat(Tok::KwInt);
-            if(cur.t!=Tok::Id) err("Expected identifier");
-            string name=cur.lex; eat(Tok::Id);
-            unique_ptr<Expr> init;
-            if(accept(Tok::Assign)) init=expr();
-            eat(Tok::Semicolon);
-            return make_unique<Decl>(name, move(init));
-        }
-        if(cur.t==Tok::Id){
-            string name=cur.lex; eat(Tok::Id); eat(Tok::Assign); auto e=expr(); eat(Tok::Semicolon);
-            return make_unique<Assign>(name, move(e));
-        }
-        if(cur.t==Tok::KwPrint){
-            eat(Tok::KwPrint); eat(Tok::LParen); auto e=expr(); eat(Tok::RParen); eat(Tok::Semicolon);
-            return make_unique<Print>(move(e));
-        }
-        if(cur.t==Tok::KwIf){
-            eat(Tok::KwIf); eat(Tok::LParen); auto c=expr(); eat(Tok::RParen);
-            auto thenS=statement(); unique_ptr<Stmt> elseS;
-            if(cur.t==Tok::KwElse){ eat(Tok::KwElse); elseS=statement(); }
-            return make_unique<IfStmt>(move(c), move(thenS), move(elseS));
-        }
-        if(cur.t==Tok::KwWhile){
-            eat(Tok::KwWhile); eat(Tok::LParen); auto c=expr(); eat(Tok::RParen);
-            auto body=statement();
-            return make_unique<WhileStmt>(move(c), move(body));
-        }
-        if(cur.t==Tok::LBrace){
-            eat(Tok::LBrace);
-            auto blk=make_unique<Block>();
-            while(cur.t!=Tok::RBrace) blk->ss.push_back(statement());
-            eat(Tok::RBrace);
-            return blk;
-        }
-        err("Invalid statement"); return nullptr;
-    }
+/*==========================================*
+ * 6c) BYTECODE INTERPRETER (--run)          *
+ *==========================================*/
+// TAC compiled to a register bytecode: every variable, temp and literal is a cell of one
+// int32 frame (literals are preloaded constant cells), labels become code offsets up
+// front, and each instruction is a word naming its handler followed by cell indices:
+//   copy r a | add/sub/mul/div r a b | print a | jmp off | jz a off | halt
+// The handler word is the handler's address as an offset from the first one, so the
+// stream stays 32-bit while dispatch is still a single indirect jump (direct threading).
+struct Bytecode {
+    vector<int32_t> code;
+    vector<int32_t> frame;
+    unordered_map<uint64_t, int32_t> cells;   // (Arg, v) -> frame index; kept across chunks
 
-    unique_ptr<Block> program(){
-        auto blk=make_unique<Block>();
-        while(cur.t!=Tok::End) blk->ss.push_back(statement());
-        return blk;
+    int32_t cell(Opnd o){
+        auto [it, fresh]=cells.try_emplace((uint64_t(uint8_t(o.k))<<32) | uint32_t(o.v), (int32_t)frame.size());
+        if(fresh) frame.push_back(o.k==Arg::Imm? o.v: 0);
+        return it->second;
     }
+    void compile(const TAC& t, const int32_t* handlers);
+    void run(Sink& out){ exec(code.data(), frame.data(), out, nullptr); }
+    static void exec(const int32_t* pc, int32_t* f, Sink& out, const int32_t** handlers);
 };
 
-/*==============================================*
- * 5) DRIVER: COMPILE → TAC (default behavior)  *
- *==============================================*/
-static void compile_stdin_to_TAC() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-    string src((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
-    Parser p(src);
-    auto ast = p.program();
-    SymbolTable sym(257);
-    TAC tac;
-    ast->gen(tac, sym);
-    cout << "=== TAC ===\n";
-    tac.dump(cout);
+// With `handlers` set, only reports the handler offsets (indexed copy..halt) and returns.
+void Bytecode::exec(const int32_t* pc, int32_t* f, Sink& out, const int32_t** handlers){
+    #define BC_OFF(l) int32_t((const char*)&&l-(const char*)&&op_copy)
+    static const int32_t H[]={BC_OFF(op_copy), BC_OFF(op_add), BC_OFF(op_sub), BC_OFF(op_mul), BC_OFF(op_div),
+                              BC_OFF(op_print), BC_OFF(op_jmp), BC_OFF(op_jz), BC_OFF(op_halt)};
+    #undef BC_OFF
+    if(handlers){ *handlers=H; return; }
+    const int32_t* const start=pc;
+    #define BC_NEXT goto *(const void*)((const char*)&&op_copy+*pc)
+    BC_NEXT;
+op_copy:  f[pc[1]]=f[pc[2]]; pc+=3; BC_NEXT;
+op_add:   f[pc[1]]=int32_t(uint32_t(f[pc[2]])+uint32_t(f[pc[3]])); pc+=4; BC_NEXT;
+op_sub:   f[pc[1]]=int32_t(uint32_t(f[pc[2]])-uint32_t(f[pc[3]])); pc+=4; BC_NEXT;
+op_mul:   f[pc[1]]=int32_t(uint32_t(f[pc[2]])*uint32_t(f[pc[3]])); pc+=4; BC_NEXT;
+op_div: {
+    int32_t a=f[pc[2]], b=f[pc[3]];
+    if(!b) throw runtime_error("Division by zero");
+    f[pc[1]]= b==-1? int32_t(0u-uint32_t(a)): a/b; pc+=4; BC_NEXT;
+}
+op_print: out << f[pc[1]] << '\n'; pc+=2; BC_NEXT;
+op_jmp:   pc=start+pc[1]; BC_NEXT;
+op_jz:    pc= f[pc[1]]? pc+3: start+pc[2]; BC_NEXT;
+op_halt:  return;
+    #undef BC_NEXT
 }
 
-/*==============================================*
- * 6) EXTRA: ASSEMBLY CODE GENERATOR (--asm)     *
- *==============================================*/
-static void generate_assembly_from_TAC() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-    string src((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
-
-    Parser p(src);
-    auto ast = p.program();
-    SymbolTable sym(257);
-    TAC tac;
-    ast->gen(tac, sym);
-
-    cout << "=== PSEUDO ASSEMBLY CODE ===\n";
-    for (auto &i : tac.code) {
-        if (i.op == "=") cout << "MOV " << i.res << ", " << i.a1 << "\n";
-        else if (i.op == "print") cout << "PRINT " << i.a1 << "\n";
-        else if (i.op == "label") cout << i.res << ":\n";
-        else if (i.op == "goto") cout << "JMP " << i.res << "\n";
-        else if (i.op == "ifz") { cout << "CMP " << i.a1 << ", 0\n"; cout << "JE " << i.res << "\n"; }
-        else if (i.op == "+") { cout << "MOV R1, " << i.a1 << "\nADD R1, " << i.a2 << "\nMOV " << i.res << ", R1\n"; }
-        else if (i.op == "-") { cout << "MOV R1, " << i.a1 << "\nSUB R1, " << i.a2 << "\nMOV " << i.res << ", R1\n"; }
-        else if (i.op == "*") { cout << "MOV R1, " << i.a1 << "\nMUL R1, " << i.a2 << "\nMOV " << i.res << ", R1\n"; }
-        else if (i.op == "/") { cout << "MOV R1, " << i.a1 << "\nDIV R1, " << i.a2 << "\nMOV " << i.res << ", R1\n"; }
+void Bytecode::compile(const TAC& t, const int32_t* H){
+    enum { COPY, ADD, SUB, MUL, DIV, PRINT, JMP, JZ, HALT };
+    static const int width[]={0,2,3,3,2,4,4,4,4};   // per Op: words emitted
+    unordered_map<int32_t, int32_t> at;              // label -> code offset
+    int32_t pos=0;
+    for(const Instr& i: t.code){ if(i.op==Op::Label) at[i.r]=pos; pos+=width[(int)i.op]; }
+    auto target=[&](int32_t l){
+        auto it=at.find(l);
+        if(it==at.end()) throw logic_error("bytecode: jump to undefined label");
+        return it->second;
+    };
+    code.clear(); code.reserve(size_t(pos)+1);
+    for(const Instr& i: t.code){
+        switch(i.op){
+            case Op::Label: break;
+            case Op::Goto:  code.insert(code.end(), {H[JMP], target(i.r)}); break;
+            case Op::Ifz:   code.insert(code.end(), {H[JZ], cell(i.a1()), target(i.r)}); break;
+            case Op::Copy:  code.insert(code.end(), {H[COPY], cell(i.res()), cell(i.a1())}); break;
+            case Op::Print: code.insert(code.end(), {H[PRINT], cell(i.a1())}); break;
+            default:
+                code.insert(code.end(), {H[ADD+int(i.op)-int(Op::Add)], cell(i.res()), cell(i.a1()), cell(i.a2())});
+        }
     }
+    code.push_back(H[HALT]);
+}
+
+static void run_bytecode(const Options& o){
+    Sink out(o.out);
+    const int32_t* handlers; Bytecode::exec(nullptr, nullptr, out, &handlers);
+    Bytecode bc;
+    lower_program(o, out, "", [&](const TAC& tac){ bc.compile(tac, handlers); bc.run(out); });
+    out.close();
 }
 
 /*=============================================================*
@@ -387,6 +2800,133 @@ static unordered_map<string, unordered_set<string>> FOLLOW(
     return Fo;
 }
 
+// FIRST/FOLLOW for large grammars: symbols interned to ints, sets as dense bitset rows
+// over the terminal columns (plus "$"), nullability kept apart instead of an ε column.
+// FIRST runs a production worklist: a production is revisited only when FIRST or
+// nullability of a symbol on its right-hand side changed. FOLLOW first seeds each
+// occurrence with FIRST of its suffix (one right-to-left pass per production), then
+// pushes FOLLOW(A) along A -> B edges (B ends A's production up to a nullable tail)
+// with a nonterminal worklist. The sets equal FIRST() / FOLLOW() above; an ε symbol on a
+// right-hand side is treated as the empty string.
+struct FirstFollow {
+    vector<string> names;                 // symbol id -> name
+    unordered_map<string, int> ids;
+    vector<char> nonterm, nullable;
+    vector<int> col;                      // symbol id -> terminal column, -1 for nonterminals
+    vector<string> cols;                  // column -> terminal name; the last one is "$"
+    size_t W=0;                           // 64-bit words per row
+    vector<int> lhs; vector<vector<int>> rhs;
+    vector<uint64_t> first, follow;       // row per symbol
+
+    explicit FirstFollow(const Grammar& G){
+        auto intern=[&](const string& s, bool nt){
+            auto [it, fresh]=ids.try_emplace(s, (int)names.size());
+            if(fresh){ names.push_back(s); nonterm.push_back(nt); }
+            else if(nt) nonterm[(size_t)it->second]=1;
+            return it->second;
+        };
+        for(const auto& A: G.nonterm) intern(A, true);
+        for(const auto& pr: G.P) intern(pr.first, true);
+        for(const auto& t: G.term) if(t!=G.EPS) intern(t, false);
+        for(const auto& pr: G.P){
+            int A=ids.at(pr.first);
+            for(const auto& alt: pr.second){
+                vector<int> r;
+                for(const auto& X: alt) if(X!=G.EPS) r.push_back(intern(X, false));
+                lhs.push_back(A); rhs.push_back(move(r));
+            }
+        }
+        size_t S=names.size();
+        col.assign(S, -1);
+        for(size_t x=0;x<S;++x) if(!nonterm[x]){ col[x]=(int)cols.size(); cols.push_back(names[x]); }
+        cols.push_back("$");
+        W=(cols.size()+63)/64;
+        first.assign(S*W, 0); follow.assign(S*W, 0); nullable.assign(S, 0);
+        for(size_t x=0;x<S;++x) if(col[x]>=0) set_bit(row(first,(int)x), col[x]);
+        compute_first();
+        if(!G.start.empty() && ids.count(G.start)) set_bit(row(follow, ids.at(G.start)), int(cols.size()-1));
+        compute_follow();
+    }
+
+    uint64_t* row(vector<uint64_t>& v, int x){ return v.data()+size_t(x)*W; }
+    static void set_bit(uint64_t* r, int c){ r[c>>6]|=uint64_t(1)<<(c&63); }
+    bool or_into(uint64_t* d, const uint64_t* s) const {
+        uint64_t diff=0;
+        for(size_t k=0;k<W;++k){ uint64_t n=d[k]|s[k]; diff|=n^d[k]; d[k]=n; }
+        return diff!=0;
+    }
+
+    void compute_first(){
+        size_t S=names.size(), P=lhs.size();
+        vector<vector<int>> uses(S);      // symbol -> productions whose rhs mentions it
+        for(size_t p=0;p<P;++p) for(int X: rhs[p]) if(nonterm[(size_t)X]) uses[(size_t)X].push_back((int)p);
+        for(auto& u: uses){ sort(u.begin(), u.end()); u.erase(unique(u.begin(), u.end()), u.end()); }
+        vector<int> work(P); iota(work.begin(), work.end(), 0);
+        vector<char> queued(P, 1);
+        while(!work.empty()){
+            int p=work.back(); work.pop_back(); queued[(size_t)p]=0;
+            int A=lhs[(size_t)p]; bool changed=false, all=true;
+            for(int X: rhs[(size_t)p]){
+                if(X!=A) changed|=or_into(row(first,A), row(first,X));
+                if(!nullable[(size_t)X]){ all=false; break; }
+            }
+            if(all && !nullable[(size_t)A]){ nullable[(size_t)A]=1; changed=true; }
+            if(changed) for(int q: uses[(size_t)A]) if(!queued[(size_t)q]){ queued[(size_t)q]=1; work.push_back(q); }
+        }
+    }
+
+    void compute_follow(){
+        size_t S=names.size();
+        vector<vector<int>> edges(S);     // A -> B: FOLLOW(A) flows into FOLLOW(B)
+        vector<uint64_t> acc(W);
+        for(size_t p=0;p<lhs.size();++p){
+            int A=lhs[p]; bool tail_nullable=true;
+            fill(acc.begin(), acc.end(), 0);
+            for(size_t i=rhs[p].size(); i-->0; ){
+                int X=rhs[p][i];
+                if(nonterm[(size_t)X]){
+                    or_into(row(follow,X), acc.data());
+                    if(tail_nullable && X!=A) edges[(size_t)A].push_back(X);
+                }
+                if(!nullable[(size_t)X]){ fill(acc.begin(), acc.end(), 0); tail_nullable=false; }
+                or_into(acc.data(), row(first,X));
+            }
+        }
+        for(auto& e: edges){ sort(e.begin(), e.end()); e.erase(unique(e.begin(), e.end()), e.end()); }
+        vector<int> work; vector<char> queued(S, 0);
+        for(size_t x=0;x<S;++x) if(nonterm[x]){ work.push_back((int)x); queued[x]=1; }
+        while(!work.empty()){
+            int A=work.back(); work.pop_back(); queued[(size_t)A]=0;
+            for(int B: edges[(size_t)A])
+                if(or_into(row(follow,B), row(follow,A)) && !queued[(size_t)B]){ queued[(size_t)B]=1; work.push_back(B); }
+        }
+    }
+
+    // Members of symbol x's row, in column order.
+    template<class F> void each(const vector<uint64_t>& v, int x, F&& f) const {
+        const uint64_t* r=v.data()+size_t(x)*W;
+        for(size_t k=0;k<W;++k) for(uint64_t m=r[k]; m; m&=m-1) f(cols[k*64+size_t(__builtin_ctzll(m))]);
+    }
+    // Same shapes as FIRST() (every symbol) and FOLLOW() (nonterminals).
+    unordered_map<string, unordered_set<string>> first_sets(const string& eps) const {
+        unordered_map<string, unordered_set<string>> F;
+        for(size_t x=0;x<names.size();++x){
+            auto& s=F[names[x]];
+            each(first, (int)x, [&](const string& a){ s.insert(a); });
+            if(nullable[x]) s.insert(eps);
+        }
+        return F;
+    }
+    unordered_map<string, unordered_set<string>> follow_sets() const {
+        unordered_map<string, unordered_set<string>> F;
+        for(size_t x=0;x<names.size();++x) if(nonterm[x]){
+            auto& s=F[names[x]];
+            each(follow, (int)x, [&](const string& a){ s.insert(a); });
+        }
+        return F;
+    }
+};
+
 static Grammar eliminate_left_recursion(const Grammar& G){
     Grammar H = G;
     vector<string> order(H.nonterm.begin(), H.nonterm.end());
@@ -427,7 +2967,7 @@ static Grammar left_factor(const Grammar& G){
                 groups[key].push_back(alt);
             }
             for(const auto& g: groups){
-                if(g.second.size()<=1) continue;
+                if(g.second.size()<=1 || g.first==H.EPS) continue;  // ε | ε: nothing to factor
                 vector<string> lcp = g.second[0];
                 for(const auto& alt: g.second){
                     size_t k=0; while(k<lcp.size() && k<alt.size() && lcp[k]==alt[k]) k++;
@@ -462,22 +3002,74 @@ static Grammar left_factor(const Grammar& G){
     return H;
 }
 
-static void print_grammar(const Grammar& G, const string& title){
-    cout << "\n== " << title << " ==\n";
+// Same factoring as left_factor() in one pass: the alternatives of each nonterminal go
+// into a prefix trie, every unary chain becomes a shared prefix and every node that
+// branches (or ends an alternative and continues) gets a fresh primed nonterminal.
+// Duplicate alternatives collapse; ε symbols are dropped, an empty alternative is ε.
+static Grammar left_factor_trie(const Grammar& G){
+    Grammar H; H.start=G.start; H.nonterm=G.nonterm; H.term=G.term;
+    struct TNode { int sym; bool end=false; vector<int> items; };   // items: kids, -1 = end
+    vector<TNode> trie;
+    unordered_map<uint64_t, int> kid;                                // (node, sym) -> node
+    unordered_map<string, int> sym_id; vector<const string*> syms;
+    unordered_map<string, string> last;                              // base -> last name issued
+    auto fresh=[&](const string& base){
+        auto it=last.find(base);
+        string A=(it==last.end()? base: it->second)+"'";
+        while(H.nonterm.count(A) || H.term.count(A)) A+="'";
+        H.nonterm.insert(A); last[base]=A;
+        return A;
+    };
+    vector<pair<int, string>> work;
+    for(const auto& pr: G.P){
+        trie.assign(1, TNode{-1, false, {}}); kid.clear();
+        for(const auto& alt: pr.second){
+            int at=0;
+            for(const auto& X: alt){
+                if(X==G.EPS) continue;
+                auto s=sym_id.emplace(X, (int)syms.size());
+                if(s.second) syms.push_back(&s.first->first);
+                auto k=kid.emplace(uint64_t(at)<<32 | uint32_t(s.first->second), (int)trie.size());
+                if(k.second){ trie[(size_t)at].items.push_back((int)trie.size()); trie.push_back(TNode{s.first->second, false, {}}); }
+                at=k.first->second;
+            }
+            if(!trie[(size_t)at].end){ trie[(size_t)at].end=true; trie[(size_t)at].items.push_back(-1); }
+        }
+        work.assign(1, {0, pr.first});
+        while(!work.empty()){
+            auto [n, A]=work.back(); work.pop_back();
+            auto& alts=H.P[A];
+            for(int c: trie[(size_t)n].items){
+                if(c<0){ alts.push_back({G.EPS}); continue; }
+                vector<string> alt{*syms[(size_t)trie[(size_t)c].sym]};
+                while(!trie[(size_t)c].end && trie[(size_t)c].items.size()==1){
+                    c=trie[(size_t)c].items[0];
+                    alt.push_back(*syms[(size_t)trie[(size_t)c].sym]);
+                }
+                if(trie[(size_t)c].items.size()>1){ alt.push_back(fresh(pr.first)); work.push_back({c, alt.back()}); }
+                alts.push_back(move(alt));
+            }
+        }
+    }
+    return H;
+}
+
+static void print_grammar(const Grammar& G, const string& title, Sink& out){
+    out << "\n== " << title << " ==\n";
     for(const auto& pr: G.P){
-        cout << pr.first << " -> ";
+        out << pr.first << " -> ";
         for(size_t i=0;i<pr.second.size();++i){
             const auto& alt = pr.second[i];
             for(size_t j=0;j<alt.size();++j){
-                cout << alt[j] << (j+1<alt.size()? " ":"");
+                out << alt[j] << (j+1<alt.size()? " ":"");
             }
-            if(i+1<pr.second.size()) cout << " | ";
+            if(i+1<pr.second.size()) out << " | ";
         }
-        cout << "\n";
+        out << "\n";
     }
 }
 
-static void demo_grammar_tools(){
+static Grammar demo_grammar(){
     Grammar G;
     G.start="S";
     G.nonterm={"S","ST","E","T","F"};
@@ -490,42 +3082,843 @@ static void demo_grammar_tools(){
     G.P["E"]  = { {"E","+","T"}, {"E","-","T"}, {"T"} };
     G.P["T"]  = { {"T","*","F"}, {"T","/","F"}, {"F"} };
     G.P["F"]  = { {"(","E",")"}, {"id"} };
+    return G;
+}
 
-    print_grammar(G, "Original Grammar");
+static void demo_grammar_tools(){
+    Sink out;
+    Grammar G=demo_grammar();
+    print_grammar(G, "Original Grammar", out);
     auto Fst = FIRST(G);
-    cout << "\nFIRST sets:\n";
+    out << "\nFIRST sets:\n";
     for(const auto& kv: Fst){ if(!is_nonterm(G,kv.first)) continue;
-        cout<< "FIRST("<<kv.first<<") = { ";
-        bool first=true; for(const auto& a: kv.second){ if(!first) cout<<", "; cout<<a; first=false; }
-        cout << " }\n";
+        out<< "FIRST("<<kv.first<<") = { ";
+        bool first=true; for(const auto& a: kv.second){ if(!first) out<<", "; out<<a; first=false; }
+        out << " }\n";
     }
     auto Fol = FOLLOW(G, Fst);
-    cout << "\nFOLLOW sets:\n";
+    out << "\nFOLLOW sets:\n";
     for(const auto& kv: Fol){
-        cout<< "FOLLOW("<<kv.first<<") = { ";
-        bool first=true; for(const auto& a: kv.second){ if(!first) cout<<", "; cout<<a; first=false; }
-        cout << " }\n";
+        out<< "FOLLOW("<<kv.first<<") = { ";
+        bool first=true; for(const auto& a: kv.second){ if(!first) out<<", "; out<<a; first=false; }
+        out << " }\n";
     }
 
     auto G1 = eliminate_left_recursion(G);
-    print_grammar(G1, "After Left Recursion Elimination");
+    print_grammar(G1, "After Left Recursion Elimination", out);
 
     auto G2 = left_factor(G1);
-    print_grammar(G2, "After Left Factoring");
+    print_grammar(G2, "After Left Factoring", out);
+    out.close();
+}
+
+// --grammar FILE: one rule per line, `A -> x y | z` (or `::=`), continuation lines that
+// start with `|`, and `#` comment lines; `ε` / `eps` or nothing is the empty alternative.
+// The first left-hand side is the start symbol, every left-hand side a nonterminal and
+// everything else a terminal. One pass over the mmap'd file, tokens cut in place.
+// parse_grammar() takes the text itself; `path` only labels errors.
+static Grammar parse_grammar(string_view v, const string& path){
+    Grammar G;
+    vector<vector<string>>* rule=nullptr;
+    vector<string_view> tok; vector<string> alt;
+    auto is_space=[](char c){ return c==' ' || c=='\t' || c=='\r'; };
+    size_t line=0;
+    for(size_t at=0; at<v.size(); ){
+        size_t nl=v.find('\n', at); if(nl==string_view::npos) nl=v.size();
+        string_view l=v.substr(at, nl-at); at=nl+1; ++line;
+        tok.clear();
+        for(size_t i=0;i<l.size();){
+            while(i<l.size() && is_space(l[i])) ++i;
+            size_t j=i; while(j<l.size() && !is_space(l[j])) ++j;
+            if(j>i) tok.push_back(l.substr(i, j-i));
+            i=j;
+        }
+        if(tok.empty() || tok[0][0]=='#') continue;
+        size_t k;
+        if(tok.size()>=2 && (tok[1]=="->" || tok[1]=="::=")){
+            string A(tok[0]);
+            if(G.start.empty()) G.start=A;
+            G.nonterm.insert(A); rule=&G.P[A]; k=2;
+        } else if(tok[0]=="|" && rule) k=1;
+        else throw runtime_error(path+":"+to_string(line)+": expected 'A -> ...' or '| ...'");
+        auto finish=[&]{
+            if(alt.empty() || (alt.size()==1 && (alt[0]==G.EPS || alt[0]=="eps"))) alt.assign(1, G.EPS);
+            rule->push_back(move(alt)); alt.clear();
+        };
+        for(; k<tok.size(); ++k){ if(tok[k]=="|") finish(); else alt.emplace_back(tok[k]); }
+        finish();
+    }
+    if(G.P.empty()) throw runtime_error(path+": no rules");
+    for(const auto& pr: G.P) for(const auto& a: pr.second) for(const auto& X: a)
+        if(X!=G.EPS && !G.nonterm.count(X)) G.term.insert(X);
+    return G;
+}
+static Grammar read_grammar(const string& path){ Source src(path); return parse_grammar(src.view(), path); }
+
+static void print_sets(const FirstFollow& ff, const vector<uint64_t>& rows, bool eps, const char* what, const string& EPS, Sink& out){
+    for(size_t x=0;x<ff.names.size();++x){
+        if(!ff.nonterm[x]) continue;
+        out << what << '(' << ff.names[x] << ") = { ";
+        bool first=true;
+        ff.each(rows, (int)x, [&](const string& a){ if(!first) out << ", "; out << a; first=false; });
+        if(eps && ff.nullable[x]){ if(!first) out << ", "; out << EPS; }
+        out << " }\n";
+    }
+}
+
+/*==================================================*
+ * 7b) LL(1) TABLE & TABLE-DRIVEN PARSER (--ll1)    *
+ *==================================================*/
+// Predictive table over FirstFollow's symbols: one int32 cell per (nonterminal, column)
+// holding a production or -1. A cell claimed twice is a conflict, kept for the report;
+// the non-nullable production wins (so `else` binds to the nearest `if`), then the first.
+// Right-hand sides sit reversed in one flat array, ready to be pushed onto a parse stack.
+struct LL1Table {
+    FirstFollow ff;
+    size_t C=0;                           // columns; C-1 is "$"
+    vector<int> row;                      // symbol -> table row, -1 for terminals
+    vector<int32_t> cell;                 // row*C + column -> production, -1 = error
+    vector<int32_t> rev; vector<uint32_t> at;   // rhs of p reversed: rev[at[p], at[p+1])
+    vector<string> conflicts;
+
+    explicit LL1Table(const Grammar& G): ff(G), C(ff.cols.size()), row(ff.names.size(), -1) {
+        int R=0;
+        for(size_t x=0;x<ff.names.size();++x) if(ff.nonterm[x]) row[x]=R++;
+        cell.assign(size_t(R)*C, -1);
+        size_t P=ff.lhs.size();
+        vector<char> nul(P, 1); vector<uint64_t> acc(ff.W);
+        at.push_back(0);
+        for(size_t p=0;p<P;++p){
+            const auto& r=ff.rhs[p];
+            rev.insert(rev.end(), r.rbegin(), r.rend()); at.push_back((uint32_t)rev.size());
+            fill(acc.begin(), acc.end(), 0);
+            for(int X: r){ ff.or_into(acc.data(), ff.row(ff.first, X)); if(!ff.nullable[(size_t)X]){ nul[p]=0; break; } }
+            int A=ff.lhs[p];
+            if(nul[p]) ff.or_into(acc.data(), ff.row(ff.follow, A));
+            for(size_t k=0;k<ff.W;++k) for(uint64_t m=acc[k]; m; m&=m-1){
+                size_t c=k*64+size_t(__builtin_ctzll(m));
+                int32_t& q=cell[size_t(row[(size_t)A])*C+c];
+                if(q<0){ q=(int32_t)p; continue; }
+                conflicts.push_back("M["+ff.names[(size_t)A]+", "+ff.cols[c]+"]: "+production((size_t)q)+"  vs  "+production(p));
+                if(nul[(size_t)q] && !nul[p]) q=(int32_t)p;
+            }
+        }
+    }
+    int32_t predict(int A, size_t c) const { return cell[size_t(row[(size_t)A])*C+c]; }
+    string production(size_t p) const {
+        string s=ff.names[(size_t)ff.lhs[p]]+" ->";
+        if(ff.rhs[p].empty()) s+=" ε";
+        for(int X: ff.rhs[p]) s+=" "+ff.names[(size_t)X];
+        return s;
+    }
+    void print(Sink& out) const {
+        out << "\n== LL(1) Table ==\n";
+        for(size_t x=0;x<ff.names.size();++x){
+            if(!ff.nonterm[x]) continue;
+            for(size_t c=0;c<C;++c) if(int32_t p=predict((int)x, c); p>=0)
+                out << "M[" << ff.names[x] << ", " << ff.cols[c] << "] = " << production((size_t)p) << "\n";
+        }
+        out << (conflicts.empty()? "LL(1): no conflicts\n": "LL(1) conflicts (resolved as above):\n");
+        for(const auto& s: conflicts) out << "  " << s << "\n";
+    }
+};
+
+// Parser's language as a Grammar, run through eliminate_left_recursion and
+// left_factor_trie. The @-symbols are markers with a single ε rule: the table treats them
+// like any nullable nonterminal, the engine runs them as actions on its value stack.
+static Grammar language_grammar(){
+    Grammar G;
+    G.start="P";
+    G.term={"id","num","int","if","else","while","print","+","-","*","/","=","(",")","{","}",";"};
+    G.P["P"]   = { {"@open","SL","@block"} };
+    G.P["SL"]  = { {"ST","SL"}, {G.EPS} };
+    G.P["ST"]  = { {"int","id",";","@decl"},
+                   {"int","id","=","E",";","@decli"},
+                   {"id","=","E",";","@assign"},
+                   {"print","(","E",")",";","@print"},
+                   {"if","(","E",")","ST","ELSE"},
+                   {"while","(","E",")","ST","@while"},
+                   {"{","@open","SL","}","@block"} };
+    G.P["ELSE"]= { {"else","ST","@ifelse"}, {"@if"} };
+    G.P["E"]   = { {"E","+","T","@add"}, {"E","-","T","@sub"}, {"T"} };
+    G.P["T"]   = { {"T","*","F","@mul"}, {"T","/","F","@div"}, {"F"} };
+    G.P["F"]   = { {"(","E",")"}, {"num"}, {"id","@var"} };
+    for(auto& pr: G.P) G.nonterm.insert(pr.first);
+    for(const char* a: {"@open","@block","@decl","@decli","@assign","@print","@if","@ifelse","@while","@var","@add","@sub","@mul","@div"}){
+        G.nonterm.insert(a); G.P[a]={{G.EPS}};
+    }
+    return left_factor_trie(eliminate_left_recursion(G));
+}
+
+// Predictive parsing of the Lexer's tokens on an explicit symbol stack, so nesting depth is
+// bounded only by memory, as in Parser. Builds the same AST as Parser. id and num
+// push their value when matched; an action pops its operands and pushes the node.
+// Errors use Parser's wording: a token that cannot start a statement where one is due is
+// "Invalid statement", one that cannot start an operand "Expected factor", and `int` not
+// followed by a name "Expected identifier"; everything else is "Unexpected token".
+struct LL1Parser {
+    enum Act : uint8_t { None, Open, EndBlock, Decl0, DeclInit, Let, Out, If, IfElse, While, Ref, Add, Sub, Mul, Div };
+    struct Lang {
+        LL1Table T{language_grammar()};
+        vector<uint8_t> act;              // symbol -> Act
+        vector<uint8_t> starts;           // nonterminal -> 1 statement, 2 operand
+        array<int, 18> col{};             // Tok -> column
+        int P, ST, SL, id, rbrace;
+        Lang(): act(T.ff.names.size(), None), starts(T.ff.names.size(), 0), P(T.ff.ids.at("P")), ST(T.ff.ids.at("ST")),
+                SL(T.ff.ids.at("SL")), id(T.ff.ids.at("id")), rbrace(T.ff.ids.at("}")) {
+            for(const char* x: {"P","SL","ST","ELSE"}) starts[(size_t)T.ff.ids.at(x)]=1;   // ELSE: what follows an if
+            for(const char* x: {"E","T","F"}) starts[(size_t)T.ff.ids.at(x)]=2;
+            static const pair<const char*, Act> acts[]={{"@open",Open},{"@block",EndBlock},{"@decl",Decl0},
+                {"@decli",DeclInit},{"@assign",Let},{"@print",Out},{"@if",If},{"@ifelse",IfElse},{"@while",While},
+                {"@var",Ref},{"@add",Add},{"@sub",Sub},{"@mul",Mul},{"@div",Div}};
+            for(const auto& [s, a]: acts) act[(size_t)T.ff.ids.at(s)]=a;
+            static const char* toks[]={"$","id","num","int","if","else","while","print",
+                "+","-","*","/","=","(",")","{","}",";"};
+            for(size_t k=0;k<col.size();++k) col[k]= k? T.ff.col[(size_t)T.ff.ids.at(toks[k])]: int(T.C-1);
+            if(T.conflicts.size()!=1) throw logic_error("language grammar: expected only the dangling-else conflict");
+        }
+    };
+    static const Lang& lang(){ static const Lang L; return L; }
+
+    const Lang& L; Lexer lex; Token cur; Arena& A;
+    struct Val { Node* n; uint32_t id; };
+    vector<int32_t> st; vector<Val> vals; vector<size_t> marks; vector<Stmt*> ss;
+
+    LL1Parser(string_view src, Arena& arena): L(lang()), lex(src), A(arena) { cur=lex.next(); }
+    [[noreturn]] void err(const string& m){ throw runtime_error(m+" at line "+to_string(cur.line)); }
+    bool at_end() const { return cur.t==Tok::End; }
+    Block* program(){
+        Node* b=run(L.P);
+        if(!at_end()) err("Invalid statement");   // only `}` gets here, which Parser takes for a statement
+        return (Block*)b;
+    }
+    Stmt* statement(){ return (Stmt*)run(L.ST); }
+
+    Node* run(int start){
+        const LL1Table& T=L.T;
+        st.assign(1, start);
+        while(!st.empty()){
+            int X=st.back(); st.pop_back();
+            int c=L.col[(size_t)cur.t];
+            if(T.ff.col[(size_t)X]>=0){
+                if(T.ff.col[(size_t)X]!=c){
+                    if(X==L.id) err("Expected identifier");        // only `int` is followed by a bare id
+                    if(X==L.rbrace) err("Invalid statement");      // end of input inside a block
+                    err("Unexpected token: "+string(cur.lex));
+                }
+                shift(); continue;
+            }
+            if(uint8_t a=L.act[(size_t)X]){ reduce(a); continue; }
+            int32_t p=T.predict(X, (size_t)c);
+            if(p<0){
+                if(L.starts[(size_t)X]==1) err("Invalid statement");
+                if(L.starts[(size_t)X]==2) err("Expected factor");
+                err("Unexpected token: "+string(cur.lex));
+            }
+            st.insert(st.end(), T.rev.begin()+T.at[(size_t)p], T.rev.begin()+T.at[(size_t)p+1]);
+        }
+        Node* n=vals.back().n; vals.pop_back(); return n;
+    }
+    void shift(){
+        if(cur.t==Tok::Id) vals.push_back({nullptr, cur.sym});
+        else if(cur.t==Tok::Num){
+            int v=0; auto r=from_chars(cur.lex.data(), cur.lex.data()+cur.lex.size(), v);
+            if(r.ec!=errc()) err("Number out of range: "+string(cur.lex));
+            vals.push_back({A.make<Num>(v), 0});
+        }
+        cur=lex.next();
+    }
+    Val pop(){ Val v=vals.back(); vals.pop_back(); return v; }
+    Expr* expr(){ return (Expr*)pop().n; }
+    Stmt* stmt(){ return (Stmt*)pop().n; }
+    void reduce(uint8_t a){
+        Node* n=nullptr;
+        switch(a){
+            case Open: marks.push_back(vals.size()); return;
+            case EndBlock: {
+                size_t m=marks.back(); marks.pop_back();
+                ss.clear(); for(size_t k=m;k<vals.size();++k) ss.push_back((Stmt*)vals[k].n);
+                vals.resize(m);
+                Block* b=A.make<Block>(); b->ss=A.copy(ss); b->n=(uint32_t)ss.size(); n=b; break;
+            }
+            case Decl0:    n=A.make<::Decl>(pop().id, nullptr); break;
+            case DeclInit: { Expr* e=expr(); n=A.make<::Decl>(pop().id, e); break; }
+            case Let:      { Expr* e=expr(); n=A.make<Assign>(pop().id, e); break; }
+            case Out:      n=A.make<Print>(expr()); break;
+            case If:       { Stmt* s=stmt(); n=A.make<IfStmt>(expr(), s, nullptr); break; }
+            case IfElse:   { Stmt* e=stmt(); Stmt* s=stmt(); n=A.make<IfStmt>(expr(), s, e); break; }
+            case While:    { Stmt* s=stmt(); n=A.make<WhileStmt>(expr(), s); break; }
+            case Ref:      n=A.make<Var>(pop().id); break;
+            default: {
+                static const Op ops[]={Op::Add, Op::Sub, Op::Mul, Op::Div};
+                Expr* r=expr(); n=A.make<BinOp>(ops[a-Add], expr(), r); break;
+            }
+        }
+        vals.push_back({n, 0});
+    }
+};
+
+// The demo's report for a grammar read from a file, with FIRST/FOLLOW from FirstFollow
+// and the LL(1) table of the factored grammar.
+static void run_grammar_tools(const string& path, const string& out_path){
+    Grammar G=read_grammar(path);
+    Sink out(out_path);
+    print_grammar(G, "Original Grammar", out);
+    FirstFollow ff(G);
+    out << "\nFIRST sets:\n";  print_sets(ff, ff.first, true, "FIRST", G.EPS, out);
+    out << "\nFOLLOW sets:\n"; print_sets(ff, ff.follow, false, "FOLLOW", G.EPS, out);
+    Grammar G1=eliminate_left_recursion(G);
+    print_grammar(G1, "After Left Recursion Elimination", out);
+    Grammar G2=left_factor_trie(G1);
+    print_grammar(G2, "After Left Factoring", out);
+    LL1Table(G2).print(out);
+    out.close();
+}
+
+/*=============================*
+ * 8) BENCHMARKS (--bench)     *
+ *=============================*/
+template<class F> static double seconds(F&& f){
+    auto t0=chrono::steady_clock::now(); f();
+    return chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+}
+static void bench_report(const string& what, double units, const string& unit, double secs){
+    cout << "  " << left << setw(36) << what << right << setw(10) << fixed << setprecision(2)
+         << units/secs/1e6 << " M " << unit << "/s\n";
+}
+
+// Identifier-heavy input: mostly names of 1..12 chars, one word in five a keyword.
+static string bench_identifiers(size_t count){
+    static const char* kws[]={"int","if","else","while","print"};
+    static const char idn[]="abcdefghijklmnopqrstuvwxyz0123456789_";
+    mt19937 rng(42); string out;
+    for(size_t k=0;k<count;++k){
+        if(rng()%5==0) out+=kws[rng()%5];
+        else { size_t len=1+rng()%12; out+=idn[rng()%26]; for(size_t j=1;j<len;++j) out+=idn[rng()%37]; }
+        out+=' ';
+    }
+    return out;
+}
+
+static void bench_keywords(){
+    const size_t N=2000000;
+    string src=bench_identifiers(N);
+    vector<string> words; { istringstream in(src); string w; while(in>>w) words.push_back(w); }
+    const int reps=5; long sum=0;
+    cout << "keywords (" << N << " identifiers x " << reps << ")\n";
+
+    // Previous scheme: hash into a per-Lexer unordered_set<string>, then a compare chain on a hit.
+    unordered_set<string> kw={"int","if","else","while","print"};
+    auto chain=[&](const string& id){
+        if(kw.count(id)){
+            if(id=="int")   return Tok::KwInt;
+            if(id=="if")    return Tok::KwIf;
+            if(id=="else")  return Tok::KwElse;
+            if(id=="while") return Tok::KwWhile;
+            if(id=="print") return Tok::KwPrint;
+        }
+        return Tok::Id;
+    };
+    double t=seconds([&]{ for(int r=0;r<reps;++r) for(const auto& w: words) sum+=(int)chain(w); });
+    bench_report("unordered_set + compare chain", double(N)*reps, "ids", t);
+    t=seconds([&]{ for(int r=0;r<reps;++r) for(const auto& w: words) sum+=(int)keyword(w); });
+    bench_report("length/first-char switch", double(N)*reps, "ids", t);
+    t=seconds([&]{ for(int r=0;r<reps;++r){ Lexer lx(src); for(Token k=lx.next(); k.t!=Tok::End; k=lx.next()) sum+=(int)k.t; } });
+    bench_report("Lexer::next() end to end", double(N)*reps, "ids", t);
+    cout << "  (checksum " << sum << ")\n";
+}
+
+// Machine-generated shape: deep indentation runs and long identifiers.
+static void bench_scan(){
+    mt19937 rng(7); string src;
+    while(src.size()<(64u<<20)){
+        src.append(4*(rng()%16),' ');
+        for(int k=0;k<3;++k){ src.append(8+rng()%48,char('a'+rng()%26)); src+=k<2? " = ": ";\n"; }
+    }
+    long toks=0;
+    double t=seconds([&]{ Lexer lx(src); for(Token k=lx.next(); k.t!=Tok::End; k=lx.next()) ++toks; });
+#ifdef LEX_SIMD
+    cout << "scan (" << LEX_SIMD << "-byte vectors, " << (src.size()>>20) << " MB)\n";
+#else
+    cout << "scan (scalar, " << (src.size()>>20) << " MB)\n";
+#endif
+    bench_report("Lexer::next() bytes", double(src.size()), "B", t);
+    bench_report("Lexer::next() tokens", double(toks), "tok", t);
+}
+
+// Declare n dense IDs (as the interner hands out), then n hits and n misses, in random order.
+static void bench_symtab(){
+    cout << "symtab\n";
+    for(size_t n: {size_t(1000), size_t(100000), size_t(1000000)}){
+        vector<uint32_t> ids(n); iota(ids.begin(), ids.end(), 1u);
+        shuffle(ids.begin(), ids.end(), mt19937(1));
+        SymbolTable st; long hits=0;
+        double td=seconds([&]{ for(uint32_t id: ids) st.declare(id, Type::Int); });
+        double tf=seconds([&]{ for(uint32_t id: ids){ hits+=st.find(id)!=nullptr; hits+=st.find(id+(uint32_t)n)!=nullptr; } });
+        if(hits!=(long)n) throw runtime_error("symtab bench: wrong hit count");
+        string tag=to_string(n)+" syms";
+        bench_report(tag+" declare", double(n), "ops", td);
+        bench_report(tag+" find (50% miss)", 2.0*n, "ops", tf);
+    }
+    SymbolTable st; const int outer=100000, inner=8;
+    double t=seconds([&]{
+        for(uint32_t id=1; id<=outer; ++id) st.declare(id, Type::Int);
+        for(int r=0;r<100;++r){ st.push_scope(); for(uint32_t id=1; id<=inner*1000; id+=1000) st.declare(id, Type::Int); st.pop_scope(); }
+    });
+    bench_report("scoped shadow + pop", double(outer+100*inner), "ops", t);
+}
+
+// Straight-line arithmetic with the odd if/while, roughly what our generators produce.
+static string bench_source(size_t stmts){
+    mt19937 rng(11); string out; size_t vars=0;
+    auto var=[&]{ return "v"+to_string(rng()%vars); };
+    for(size_t k=0;k<stmts;++k){
+        unsigned r=rng()%10;
+        if(r<3 || !vars){ out+="int v"+to_string(vars)+" = "+to_string(rng()%100)+(vars? " + "+var()+" * 3;\n": ";\n"); ++vars; }
+        else if(r<8) out+=var()+" = ("+var()+" + "+to_string(1+rng()%9)+") * "+var()+" - 2 / 1;\n";
+        else if(r<9) out+="while ("+var()+") { "+var()+" = "+var()+" - 1; print("+var()+"); }\n";
+        else out+="if ("+var()+") print("+var()+"); else { print(1); }\n";
+    }
+    return out;
+}
+
+static void bench_emit(){
+    string src=bench_source(200000);
+    Arena arena; Parser p(src, arena); SymbolTable sym; TAC tac;
+    p.program()->gen(tac, sym);
+    cout << "emit (" << tac.code.size() << " TAC instrs)\n";
+    size_t bytes=0;
+    double t=seconds([&]{ Sink out("/dev/null"); tac.dump(out); bytes=out.bytes(); out.close(); });
+    bench_report("TAC::dump -> Sink", double(bytes), "B", t);
+    t=seconds([&]{ Sink out("/dev/null"); dump_asm(tac, out); bytes=out.bytes(); out.close(); });
+    bench_report("dump_asm -> Sink", double(bytes), "B", t);
+    t=seconds([&]{ Sink out("/dev/null"); RegAlloc ra(tac, 8); dump_asm(tac, ra, out); bytes=out.bytes(); out.close(); });
+    bench_report("regalloc + dump_asm -> Sink", double(bytes), "B", t);
+}
+
+// The baseline for --bench run: walks TAC::code, picks the operation by comparing
+// op_text() strings and keeps every value in a hash map. Returns instructions executed.
+static uint64_t naive_run(const TAC& t, Sink& out){
+    unordered_map<uint64_t, int32_t> env; unordered_map<int32_t, size_t> labels;
+    for(size_t k=0;k<t.code.size();++k) if(t.code[k].op==Op::Label) labels[t.code[k].r]=k;
+    auto key=[](Opnd o){ return (uint64_t(uint8_t(o.k))<<32) | uint32_t(o.v); };
+    auto val=[&](Opnd o){ return o.k==Arg::Imm? o.v: env[key(o)]; };
+    uint64_t steps=0;
+    for(size_t pc=0; pc<t.code.size(); ){
+        const Instr& i=t.code[pc++]; ++steps;
+        string op=op_text(i.op);
+        if(op=="label") continue;
+        if(op=="goto"){ pc=labels[i.r]; continue; }
+        if(op=="ifz"){ if(!val(i.a1())) pc=labels[i.r]; continue; }
+        if(op=="print"){ out << val(i.a1()) << '\n'; continue; }
+        if(op=="="){ env[key(i.res())]=val(i.a1()); continue; }
+        uint32_t a=(uint32_t)val(i.a1()), b=(uint32_t)val(i.a2()); int32_t r;
+        if(op=="+") r=int32_t(a+b);
+        else if(op=="-") r=int32_t(a-b);
+        else if(op=="*") r=int32_t(a*b);
+        else { if(!b) throw runtime_error("Division by zero"); r= int32_t(b)==-1? int32_t(0u-a): int32_t(a)/int32_t(b); }
+        env[key(i.res())]=r;
+    }
+    return steps;
+}
+
+static void bench_run(){
+    const char* src=
+        "int i = 3000; int s = 0; int k = 7;\n"
+        "while (i) { int j = 1000; while (j) { s = s + j * 3 - i / k; j = j - 1; } i = i - 1; print(s); }\n";
+    Arena arena; Parser p(src, arena); SymbolTable sym; TAC tac;
+    p.program()->gen(tac, sym);
+    uint64_t steps=0;
+    double t=seconds([&]{ Sink out("/dev/null"); steps=naive_run(tac, out); out.close(); });
+    cout << "run (" << steps << " TAC instrs executed)\n";
+    bench_report("naive switch on op strings", double(steps), "instr", t);
+    t=seconds([&]{
+        Sink out("/dev/null");
+        const int32_t* handlers; Bytecode::exec(nullptr, nullptr, out, &handlers);
+        Bytecode bc; bc.compile(tac, handlers); bc.run(out); out.close();
+    });
+    bench_report("direct-threaded bytecode", double(steps), "instr", t);
+}
+
+// n nonterminals N0..N{n-1} over t terminals: 1-4 alternatives of 0-5 symbols each, one
+// alternative in ten empty, so there is left recursion, nullable chains and long cycles.
+static Grammar bench_grammar(size_t n, size_t t, unsigned seed){
+    mt19937 rng(seed); Grammar G;
+    for(size_t k=0;k<n;++k) G.nonterm.insert("N"+to_string(k));
+    for(size_t k=0;k<t;++k) G.term.insert("t"+to_string(k));
+    G.start="N0";
+    for(size_t k=0;k<n;++k){
+        auto& alts=G.P["N"+to_string(k)];
+        for(unsigned a=1+rng()%4; a--; ){
+            vector<string> alt;
+            if(rng()%10) for(unsigned len=1+rng()%5; len--; )
+                alt.push_back(rng()%2? "N"+to_string(rng()%n): "t"+to_string(rng()%t));
+            alts.push_back(move(alt));
+        }
+    }
+    return G;
+}
+
+// --gen-src SHAPE N and --bench programs: N top-level statements of one shape.
+//   decls  declarations, each initialised from a few earlier names
+//   nest   if/else, blocks and (at most two deep, so --run ends) while loops, 32 deep
+//   expr   assignments of 64..256-operand expressions
+//   loop   hot while loops of 1000 trips each
+//   mixed  a random one of the above per statement, nesting 8 deep
+// Always a valid program: names are declared before use and divisors are nonzero literals.
+static const char* const program_shapes[]={"decls","nest","expr","loop","mixed"};
+static string gen_program(const string& shape, size_t n, unsigned seed=1){
+    size_t pick=size_t(find(begin(program_shapes), end(program_shapes), shape)-begin(program_shapes));
+    if(pick==size(program_shapes)) throw runtime_error("Unknown program shape: "+shape);
+    // Data names vK are assigned freely; a loop counter cK is stepped only by its own loop.
+    mt19937 rng(seed); string out="int v0 = 1;\n"; size_t vars=1, counters=0;
+    auto var=[&]{ return "v"+to_string(rng()%vars); };
+    auto leaf=[&]{ return rng()%3? var(): to_string(rng()%100); };
+    auto expr=[&](size_t ops){
+        string e=leaf();
+        for(size_t k=0;k<ops;++k){
+            switch(rng()%8){
+                case 0: case 1: e+=" + "; e+=leaf(); break;
+                case 2: case 3: e+=" - "; e+=leaf(); break;
+                case 4: e+=" * "; e+=leaf(); break;
+                case 5: e+=" * ("; e+=leaf(); e+=" + "; e+=leaf(); e+=")"; break;
+                default: e="("+e+") / "+to_string(1+rng()%9); break;
+            }
+        }
+        return e;
+    };
+    auto decl=[&]{ string d="int v"+to_string(vars)+" = "; d+=expr(rng()%4); d+=";"; ++vars; return d; };
+    auto assign=[&](size_t ops){ string a=var(); a+=" = "; a+=expr(ops); a+=";"; return a; };
+    auto loop_head=[&](int trips){
+        string c="c"+to_string(counters++);
+        return pair<string, string>{"int "+c+" = "+to_string(trips)+"; while ("+c+") { "+c+" = "+c+" - 1; ", " }"};
+    };
+    function<string(unsigned, unsigned)> nest=[&](unsigned depth, unsigned loops)->string{
+        if(!depth) return assign(3);
+        string r;
+        switch(rng()%4){
+            case 0:  r="if ("+expr(2)+") { "; r+=nest(depth-1, loops); r+=" } else "; r+=assign(2); return r;
+            case 1:  r="{ "+decl()+" "; r+=nest(depth-1, loops); r+=" print("+var()+"); }"; return r;
+            case 2:  if(loops<2){ auto [head, tail]=loop_head(3); return head+nest(depth-1, loops+1)+tail; }
+                     [[fallthrough]];
+            default: r="if ("+expr(1)+") "; r+=nest(depth-1, loops); return r;
+        }
+    };
+    for(size_t k=1;k<n;++k){
+        switch(pick==4? rng()%4: pick){
+            case 0: out+=decl(); break;
+            case 1: out+=nest(pick==4? 8: 32, 0); break;
+            case 2: out+=assign(64+rng()%193); break;
+            default: {
+                auto [head, tail]=loop_head(1000);
+                out+=head; out+=assign(4); out+=' '; out+=assign(2); out+=tail; out+=" print("+var()+");";
+                break;
+            }
+        }
+        out+='\n';
+    }
+    return out;
+}
+
+// --gen-grammar SHAPE N and --bench grammars: grammar files over N nonterminals, in
+// read_grammar's syntax.
+//   wide  1..4 short alternatives per rule over 64 terminals (bench_grammar's shape)
+//   deep  a chain N0 .. N{N-1} of nullable links, so FIRST and FOLLOW flow its whole length
+//   long  1..3 alternatives of 32..256 symbols per rule
+static const char* const grammar_shapes[]={"wide","deep","long"};
+static string gen_grammar(const string& shape, size_t n, unsigned seed=1){
+    n=max<size_t>(n, 1);
+    mt19937 rng(seed); string out;
+    auto N=[](size_t k){ return "N"+to_string(k); };
+    auto sym=[&](size_t terms){ return rng()%2? N(rng()%n): "t"+to_string(rng()%terms); };
+    if(shape=="wide"){
+        Grammar G=bench_grammar(n, 64, seed);
+        for(size_t k=0;k<n;++k){
+            out+=N(k)+" ->";
+            const auto& alts=G.P[N(k)];
+            for(size_t a=0;a<alts.size();++a){
+                if(a) out+=" |";
+                if(alts[a].empty()) out+=" eps";
+                for(const auto& X: alts[a]) out+=" "+X;
+            }
+            out+='\n';
+        }
+    } else if(shape=="deep"){
+        for(size_t k=0;k<n;++k){
+            string next= k+1<n? N(k+1): "t0";
+            out+=N(k)+" -> t"+to_string(k%64)+" "+next+" | "+next+" t"+to_string(rng()%64)+" | eps\n";
+        }
+    } else if(shape=="long"){
+        for(size_t k=0;k<n;++k){
+            out+=N(k)+" ->";
+            for(unsigned a=1+rng()%3; a--; ){
+                for(unsigned len=32+rng()%225; len--; ) out+=" "+sym(64);
+                if(a) out+=" |";
+            }
+            out+='\n';
+        }
+    } else throw runtime_error("Unknown grammar shape: "+shape);
+    return out;
+}
+
+static void bench_firstfollow(){
+    auto same=[](const Grammar& G){
+        FirstFollow ff(G);
+        auto F=FIRST(G), Fo=FOLLOW(G,F), F2=ff.first_sets(G.EPS);
+        for(const auto& A: G.nonterm) if(F[A]!=F2[A]) return false;
+        return Fo==ff.follow_sets();
+    };
+    if(!same(demo_grammar())) throw logic_error("FirstFollow disagrees with FIRST/FOLLOW on the demo grammar");
+    cout << "firstfollow (sets checked against FIRST/FOLLOW up to 1000 nonterminals)\n";
+    for(size_t n: {100, 1000, 10000, 100000}){
+        Grammar G=bench_grammar(n, 64, 5+unsigned(n));
+        size_t prods=0; for(const auto& pr: G.P) prods+=pr.second.size();
+        string tag=to_string(n)+" nonterminals";
+        if(n<=1000){
+            if(!same(G)) throw logic_error("FirstFollow disagrees with FIRST/FOLLOW at "+tag);
+            double t=seconds([&]{ auto F=FIRST(G); auto Fo=FOLLOW(G,F); });
+            bench_report("string sets, "+tag, double(prods), "prod", t);
+        }
+        double t=seconds([&]{ FirstFollow ff(G); });
+        bench_report("bitset worklist, "+tag, double(prods), "prod", t);
+    }
+}
+
+// H left-factors G: expanding the nonterminals H introduced gives back each rule's
+// alternatives (as a set, ε-free), and no two alternatives of a rule share a first symbol.
+static bool factors(const Grammar& G, const Grammar& H){
+    auto strip=[&](const vector<string>& alt){
+        vector<string> r; for(const auto& X: alt) if(X!=G.EPS) r.push_back(X);
+        return r;
+    };
+    map<string, set<vector<string>>> memo;
+    function<const set<vector<string>>&(const string&)> expand=[&](const string& A)->const set<vector<string>>& {
+        auto it=memo.find(A); if(it!=memo.end()) return it->second;
+        set<vector<string>> out;
+        for(const auto& alt: H.P.at(A)){
+            auto a=strip(alt);
+            if(a.empty() || G.nonterm.count(a.back()) || !H.nonterm.count(a.back())){ out.insert(a); continue; }
+            string B=a.back(); a.pop_back();
+            for(const auto& t: expand(B)){ auto u=a; u.insert(u.end(), t.begin(), t.end()); out.insert(u); }
+        }
+        return memo[A]=move(out);
+    };
+    for(const auto& pr: H.P){
+        unordered_set<string> heads;
+        for(const auto& alt: pr.second){ auto a=strip(alt); if(!a.empty() && !heads.insert(a[0]).second) return false; }
+    }
+    for(const auto& pr: G.P){
+        set<vector<string>> want; for(const auto& alt: pr.second) want.insert(strip(alt));
+        if(!H.P.count(pr.first) || expand(pr.first)!=want) return false;
+    }
+    return true;
+}
+
+static void bench_leftfactor(){
+    Grammar D=eliminate_left_recursion(demo_grammar());
+    if(!factors(D, left_factor(D)) || !factors(D, left_factor_trie(D)))
+        throw logic_error("left factoring is wrong on the demo grammar");
+    // Duplicate ε alternatives: left_factor once factored the empty prefix into a new
+    // A' -> ε | ε, and again on A', without end.
+    Grammar E=parse_grammar("S -> A b | A c\nA -> a | ε | ε\nB -> x B | ε | x | ε\n", "ε|ε");
+    if(!factors(E, left_factor(E)) || !factors(E, left_factor_trie(E)))
+        throw logic_error("left factoring is wrong on ε | ε");
+    cout << "leftfactor (both checked against the input grammar up to 1000 nonterminals)\n";
+    for(size_t n: {100, 1000, 10000, 100000}){
+        // Four terminals, so most rules have alternatives that share a prefix.
+        Grammar G=eliminate_left_recursion(bench_grammar(n, 4, 7+unsigned(n)));
+        size_t prods=0; for(const auto& pr: G.P) prods+=pr.second.size();
+        string tag=to_string(n)+" nonterminals";
+        if(n<=1000){
+            optional<Grammar> H; double t=seconds([&]{ H.emplace(left_factor(G)); });
+            if(!factors(G, *H)) throw logic_error("left_factor is wrong at "+tag);
+            bench_report("restart loop, "+tag, double(prods), "prod", t);
+        }
+        optional<Grammar> H; double t=seconds([&]{ H.emplace(left_factor_trie(G)); });
+        if(n<=1000 && !factors(G, *H)) throw logic_error("left_factor_trie is wrong at "+tag);
+        bench_report("prefix trie, "+tag, double(prods), "prod", t);
+    }
+}
+
+// Every phase over each gen_program() shape, about 4 MB of source apiece.
+static void bench_programs(){
+    static const size_t stmts[]={130000, 3000, 4000, 35000, 10000};
+    cout << "programs\n";
+    for(size_t s=0; s<size(program_shapes); ++s){
+        string src=gen_program(program_shapes[s], stmts[s], 3);
+        uint64_t toks=0, names=0;
+        double t=seconds([&]{ Lexer lx(src); for(Token k=lx.next(); k.t!=Tok::End; k=lx.next()) ++toks; });
+        string tag=string(program_shapes[s])+" ("+to_string(src.size()>>10)+" KB)";
+        cout << " " << tag << "\n";
+        bench_report("Lexer bytes", double(src.size()), "B", t);
+        bench_report("Lexer tokens", double(toks), "tok", t);
+        Arena arena; Block* ast=nullptr;
+        t=seconds([&]{ Parser p(src, arena); ast=p.program(); });
+        bench_report("Parser bytes", double(src.size()), "B", t);
+        bench_report("Parser tokens", double(toks), "tok", t);
+        function<void(Stmt*)> count=[&](Stmt* st){
+            switch(st->k){
+                case NK::Decl: case NK::Assign: ++names; break;
+                case NK::Block: { auto* b=static_cast<Block*>(st); for(uint32_t k=0;k<b->n;++k) count(b->ss[k]); break; }
+                case NK::If:    { auto* i=static_cast<IfStmt*>(st); count(i->thenS); if(i->elseS) count(i->elseS); break; }
+                case NK::While: count(static_cast<WhileStmt*>(st)->body); break;
+                default: break;
+            }
+        };
+        count(ast);
+        t=seconds([&]{ SymbolTable sym; for(uint32_t k=0;k<ast->n;++k) resolve_names(ast->ss[k], sym); });
+        bench_report("SymbolTable declare/find", double(names), "name", t);
+        TAC tac; SymbolTable sym;
+        t=seconds([&]{ ast->gen(tac, sym); });
+        bench_report("gen -> TAC", double(tac.code.size()), "instr", t);
+        size_t bytes=0;
+        t=seconds([&]{ Sink out("/dev/null"); tac.dump(out); bytes=out.bytes(); out.close(); });
+        bench_report("TAC::dump bytes", double(bytes), "B", t);
+        bench_report("TAC::dump instrs", double(tac.code.size()), "instr", t);
+        t=seconds([&]{ Sink out("/dev/null"); dump_asm(tac, out); out.close(); });
+        bench_report("--asm (default, every op via R1)", double(tac.code.size()), "instr", t);
+        t=seconds([&]{ Sink out("/dev/null"); RegAlloc ra(tac, 8); dump_asm(tac, ra, out); out.close(); });
+        bench_report("--asm --regs 8 (regalloc + dump_asm)", double(tac.code.size()), "instr", t);
+    }
+}
+
+// read_grammar and FirstFollow over each gen_grammar() shape.
+static void bench_grammars(){
+    cout << "grammars\n";
+    for(const char* shape: grammar_shapes){
+        for(size_t n: {1000, 10000}){
+            string text=gen_grammar(shape, n, 9);
+            optional<Grammar> G;
+            double t=seconds([&]{ G.emplace(parse_grammar(text, shape)); });
+            size_t prods=0, syms=0; for(const auto& pr: G->P) for(const auto& a: pr.second){ ++prods; syms+=a.size(); }
+            cout << " " << shape << ", " << n << " nonterminals (" << (text.size()>>10) << " KB)\n";
+            bench_report("read_grammar bytes", double(text.size()), "B", t);
+            t=seconds([&]{ FirstFollow ff(*G); });
+            bench_report("FIRST/FOLLOW productions", double(prods), "prod", t);
+            bench_report("FIRST/FOLLOW symbols", double(syms), "sym", t);
+        }
+    }
+}
+
+static void run_benchmarks(const string& which){
+    static const vector<pair<string, void(*)()>> all={
+        {"keywords", bench_keywords},
+        {"scan", bench_scan},
+        {"symtab", bench_symtab},
+        {"emit", bench_emit},
+        {"run", bench_run},
+        {"firstfollow", bench_firstfollow},
+        {"leftfactor", bench_leftfactor},
+        {"programs", bench_programs},
+        {"grammars", bench_grammars},
+    };
+    bool any=false;
+    for(const auto& b: all) if(which=="all" || which==b.first){ b.second(); any=true; }
+    if(!any) throw runtime_error("Unknown benchmark: "+which);
 }
 
 /*=============================*
- * 8) main(): mode dispatcher  *
+ * 9) main(): mode dispatcher  *
  *=============================*/
 int main(int argc, char** argv){
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
     try{
-        if(argc>1 && string(argv[1])=="--demo-grammar"){
+        string mode, bench="all", grammar, shape; size_t count=0;
+        Options o;
+        bool batch=false; vector<string> inputs;
+        optional<Stats> st;
+        const unsigned cores=max(1u, thread::hardware_concurrency());
+        unsigned jobs=cores;
+        // A count is all digits: no sign, no suffix, and not a file name such as 2024.src.
+        auto is_count=[](const char* s){ return *s && strspn(s, "0123456789")==strlen(s); };
+        // --parallel [N] and --jobs [N]: N only when the next argument is a count, so
+        // `--parallel 2024.src` keeps its input; 1 up to all cores, which is also the default.
+        auto threads=[&](int& k){
+            if(k+1<argc && is_count(argv[k+1])) return (unsigned)clamp(strtoul(argv[++k], nullptr, 10), 1ul, (unsigned long)cores);
+            return cores;
+        };
+        for(int k=1;k<argc;++k){
+            string a=argv[k];
+            if(a=="--demo-grammar" || a=="--asm" || a=="--x86-64" || a=="--run-jit" || a=="--run") mode=a;
+            else if(a=="--stream") o.stream=true;
+            else if(a=="--ll1") o.ll1=true;
+            else if(a=="--pipeline"){ o.pipeline=true; o.stream=true; }
+            else if(a=="--stats"){
+                st.emplace(); stats=&*st;
+                if(k+1<argc && string_view(argv[k+1])=="json"){ st->json=true; ++k; }
+            }
+            else if(a=="--parallel") o.parallel=threads(k);
+            else if(a=="-O0" || a=="-O1" || a=="-O2") o.opt=a[2]-'0';
+            else if(a=="--out"){ if(++k>=argc) throw runtime_error("--out needs a file"); o.out=argv[k]; }
+            else if(a=="--regs"){
+                if(++k>=argc) throw runtime_error("--regs needs a count");
+                if(!is_count(argv[k]) || strtoul(argv[k], nullptr, 10)>64) throw runtime_error("--regs must be 0..64");
+                o.regs=(int)strtoul(argv[k], nullptr, 10);
+            }
+            else if(a=="--cache-dir"){
+                if(++k>=argc) throw runtime_error("--cache-dir needs a directory");
+                o.cache_dir=argv[k];
+                if(mkdir(o.cache_dir.c_str(), 0755)<0 && errno!=EEXIST) throw runtime_error("Cannot create "+o.cache_dir);
+            }
+            else if(a=="--incremental"){
+                if(++k>=argc) throw runtime_error("--incremental needs a state file");
+                o.incremental=argv[k]; o.stream=true;
+            }
+            else if(a=="--grammar"){ if(++k>=argc) throw runtime_error("--grammar needs a file"); mode=a; grammar=argv[k]; }
+            else if(a=="--batch") batch=true;
+            else if(a=="--batch-list"){
+                if(++k>=argc) throw runtime_error("--batch-list needs a file");
+                batch=true; Source list(argv[k]); istringstream in{string(list.view())}; string line;
+                while(getline(in, line)) if(!line.empty()) inputs.push_back(line);
+            }
+            else if(a=="--jobs") jobs=threads(k);
+            else if(a=="--bench"){ mode=a; if(k+1<argc && argv[k+1][0]!='-') bench=argv[++k]; }
+            else if(a=="--gen-src" || a=="--gen-grammar"){
+                if(k+2>=argc) throw runtime_error(a+" needs a shape and a count");
+                mode=a; shape=argv[++k]; count=strtoull(argv[++k], nullptr, 10);
+            }
+            else if(a.size()>1 && a[0]=='-') throw runtime_error("Unknown option: "+a);
+            else if(batch) inputs.push_back(a);
+            else o.path=(a=="-"? "": a);
+        }
+        if(o.ll1 && !o.incremental.empty()) throw runtime_error("--ll1 does not take --incremental");
+        if(o.pipeline && (o.ll1 || !o.incremental.empty())) throw runtime_error("--pipeline does not take --ll1 or --incremental");
+        if(st && batch) throw runtime_error("--stats does not take --batch");
+        if(st && (mode=="--grammar" || mode=="--demo-grammar" || mode=="--bench" || mode.rfind("--gen-",0)==0))
+            throw runtime_error("--stats reports on compiling a program; it does not take "+mode);
+        if(batch && !o.incremental.empty()) throw runtime_error("--batch does not take --incremental (its jobs would share one state file)");
+        if(o.parallel && o.stream) throw runtime_error("--parallel lowers the whole program; it does not take --stream, --pipeline or --incremental");
+        if(o.parallel && o.opt) throw runtime_error("--parallel only lowers at -O0 (from -O1 gen depends on earlier statements)");
+        int rc=0;
+        if(batch){
+            if(inputs.empty()) throw runtime_error("--batch needs input files");
+            if(mode=="--run-jit" || mode=="--run" || mode=="--bench" || mode=="--demo-grammar" || mode=="--grammar" || mode.rfind("--gen-",0)==0) throw runtime_error(mode+" does not take --batch");
+            rc=compile_batch(o, inputs, jobs, mode);
+        } else if(mode=="--demo-grammar"){
             demo_grammar_tools();
-        } else if(argc>1 && string(argv[1])=="--asm"){
-            generate_assembly_from_TAC();
+        } else if(mode=="--grammar"){
+            run_grammar_tools(grammar, o.out);
+        } else if(mode=="--bench"){
+            run_benchmarks(bench);
+        } else if(mode=="--gen-src" || mode=="--gen-grammar"){
+            Sink out(o.out);
+            out << (mode=="--gen-src"? gen_program(shape, count): gen_grammar(shape, count));
+            out.close();
+        } else if(mode=="--asm"){
+            generate_assembly_from_TAC(o);
+        } else if(mode=="--x86-64"){
+            generate_x86_64(o);
+        } else if(mode=="--run-jit"){
+            run_jit(o);
+        } else if(mode=="--run"){
+            run_bytecode(o);
         } else {
-            compile_stdin_to_TAC();
+            compile_to_TAC(o);
         }
+        if(!o.cache_dir.empty()) cerr << "cache: " << cache_hits << " hits, " << cache_misses << " misses\n";
+        if(stats) stats->print();
+        return rc;
     } catch(const exception& e){
         cerr << "Error: " << e.what() << "\n";
         return 1;
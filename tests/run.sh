@@ -0,0 +1,254 @@
+#!/usr/bin/env bash
+# Regression checks for main.cpp. Usage: tests/run.sh [compiler]
+# Without an argument the compiler is built into a temporary directory first.
+set -u
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+if [ $# -ge 1 ]; then mc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+else
+    mc=$work/mc
+    ${CXX:-g++} -std=c++17 -O2 -pthread -o "$mc" "$here/../main.cpp" || exit 1
+fi
+cd "$work"
+failed=0
+pass(){ echo "ok   $1"; }
+fail(){ echo "FAIL $1"; failed=1; }
+
+# --run-jit must agree with --run, output and exit status, when a division traps.
+t=jit-division-by-zero
+printf 'int a = 0;\nprint(5);\nprint(7 / a);\n' > dz.src
+"$mc" --run dz.src > dz.out 2> dz.err; run_rc=$?
+"$mc" --run-jit dz.src > jit.out 2> jit.err; jit_rc=$?
+if [ $run_rc -eq 1 ] && [ $jit_rc -eq 1 ] && cmp -s dz.out jit.out && cmp -s dz.err jit.err \
+   && [ "$(cat jit.out)" = 5 ]; then pass $t; else fail $t; fi
+
+# INT_MIN / -1 wraps instead of faulting, with the divisor in a variable and as a literal.
+t=jit-int-min-by-minus-one
+printf 'int m = 0 - 2147483647 - 1;\nint n = 0 - 1;\nprint(m / n);\nprint(m / (0 - 1));\n' > mn.src
+"$mc" --run mn.src > run.out 2>&1 && "$mc" --run-jit mn.src > jit.out 2>&1 \
+   && cmp -s run.out jit.out && [ "$(cat jit.out)" = "$(printf -- '-2147483648\n-2147483648')" ] \
+   && pass $t || fail $t
+
+# The --x86-64 text backend shares the guard; its runtime reports the error itself.
+t=x86-64-division-by-zero
+if command -v as > /dev/null && command -v ld > /dev/null; then
+    "$mc" --x86-64 dz.src > dz.s && as dz.s -o dz.o && ld dz.o -o dz
+    ./dz > x86.out 2> x86.err; x86_rc=$?
+    if [ $x86_rc -eq 1 ] && cmp -s dz.out x86.out && cmp -s dz.err x86.err; then pass $t; else fail $t; fi
+else echo "skip $t (no as/ld)"; fi
+
+# A failed write inside JIT code is reported like --run does, not aborted on.
+t=jit-write-error
+if [ -w /dev/full ]; then
+    printf 'int i = 300000;\nwhile (i) { print(i); i = i - 1; }\n' > big.src
+    "$mc" --run big.src > /dev/full 2> run.err; run_rc=$?
+    "$mc" --run-jit big.src > /dev/full 2> jit.err; jit_rc=$?
+    if [ $run_rc -eq 1 ] && [ $jit_rc -eq 1 ] && cmp -s run.err jit.err; then pass $t; else fail $t; fi
+else echo "skip $t (no /dev/full)"; fi
+
+# A damaged --incremental state file is ignored: nothing is reused and the output
+# matches a fresh --stream compile.
+t=incremental-corrupt-state
+printf 'int a = 1;\nint b = a + 2;\nwhile (b) { print(b); b = b - 1; }\nprint(a * 3);\n' > inc.src
+"$mc" -O1 --stream inc.src > inc.ref
+"$mc" -O1 --incremental inc.state inc.src > /dev/null 2>&1
+ok=1
+size=$(wc -c < inc.state)
+for at in 30 $((size / 2)) $((size - 3)); do
+    cp inc.state bad.state
+    printf '\377' | dd of=bad.state bs=1 seek=$at conv=notrunc 2> /dev/null
+    "$mc" -O1 --incremental bad.state inc.src > inc.out 2> inc.err || ok=0
+    cmp -s inc.ref inc.out && grep -q 'incremental: 0 of 4 ' inc.err || ok=0
+done
+cp inc.state bad.state && truncate -s $((size - 20)) bad.state
+"$mc" -O1 --incremental bad.state inc.src > inc.out 2> inc.err || ok=0
+cmp -s inc.ref inc.out && grep -q 'incremental: 0 of 4 ' inc.err || ok=0
+"$mc" -O1 --incremental inc.state inc.src > inc.out 2> inc.err || ok=0
+cmp -s inc.ref inc.out && grep -q 'incremental: 4 of 4 ' inc.err || ok=0
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --parallel takes N only when the next argument is all digits.
+t=parallel-digit-filename
+printf 'int a = 2;\nprint(a * 21);\n' > 2024.src
+"$mc" 2024.src > seq.out && "$mc" --parallel 2024.src > par.out 2>&1 && cmp -s seq.out par.out \
+   && "$mc" --parallel 2 2024.src > par.out 2>&1 && cmp -s seq.out par.out \
+   && ! "$mc" -O1 --parallel 2024.src > /dev/null 2>&1 && pass $t || fail $t
+
+# --ll1 is a drop-in for the default parser, error messages included.
+t=ll1-error-wording
+ok=1
+for prog in 'int a = 1;\nelse print(a);' 'int a = 1;\n}' ';' 'int 5;' 'int a = ;' 'int a = 1 + * 2;' \
+            '{ int a;' 'if (1) int a; else' 'if (1) { } ( a = 1;' 'print(1;' 'int a = 1 1;'; do
+    printf '%b\n' "$prog" > bad.src
+    for flags in "" --stream; do
+        "$mc" $flags bad.src > /dev/null 2> rd.err
+        "$mc" --ll1 $flags bad.src > /dev/null 2> ll.err
+        cmp -s rd.err ll.err || ok=0
+    done
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# Duplicate ε alternatives must not send left factoring into a loop; --bench leftfactor
+# checks both implementations on an ε | ε grammar before timing them.
+t=left-factor-eps-eps
+printf 'S -> A b | A c\nA -> a | ε | ε\n' > eps.g
+timeout 20 "$mc" --grammar eps.g > eps.out 2>&1 && grep -q '^A -> a | ε$' eps.out \
+   && timeout 120 "$mc" --bench leftfactor > /dev/null 2>&1 && pass $t || fail $t
+
+# --stats only reports on compiling a program; other modes are rejected, not zeroed.
+t=stats-rejects-non-compile-modes
+! "$mc" --stats --grammar eps.g > /dev/null 2>&1 && ! "$mc" --stats --bench keywords > /dev/null 2>&1 \
+   && "$mc" --stats inc.src > /dev/null 2> st.err && grep -q '^stats: tokens  *[1-9]' st.err \
+   && pass $t || fail $t
+
+# -O1 and -O2 must not fold away a division that fails at run time.
+t=opt-keeps-trapping-division
+ok=1
+for prog in 'int a = 0;\nprint((7 / a) * 0);\nprint(9);' \
+            'int v0 = 0;\nprint(v0 - (0 - 0) * (v0 / v0 / v0 / 2));'; do
+    printf '%b\n' "$prog" > trap.src
+    "$mc" --run trap.src > o0.out 2>&1; rc0=$?
+    [ $rc0 -eq 1 ] || ok=0
+    for O in -O1 -O2; do
+        "$mc" $O --run trap.src > on.out 2>&1; [ $? -eq $rc0 ] && cmp -s o0.out on.out || ok=0
+    done
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# Nesting depth is limited by memory only: parsing and lowering keep statements off the
+# C++ stack, with either parser, and -O1 stays linear in the depth.
+t=deep-nesting
+ok=1
+n=100000
+{ echo 'int a = 1;'; for s in '{ ' 'if (a) print(1); else ' 'while (0) '; do
+      printf "$s%.0s" $(seq $n); echo 'print(a);'; done; printf ' }%.0s' $(seq $n); echo; } > deep.src
+for flags in --run "--ll1 --run" "-O1 --run" "--stream --run"; do
+    timeout 60 "$mc" $flags deep.src > deep.out 2>&1 && [ "$(cat deep.out)" = "$(printf '1\n1')" ] || ok=0
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --run prints the same output and exits with the same status at every -O level:
+# folding and identities, copy propagation, value numbering, Sethi-Ullman order and
+# hoisting, including programs that trap part way through.
+t=opt-levels-agree
+ok=1
+for prog in 'int x = 7;\nprint(x * 0 + x * 1 + 0 - 0);\nprint((x + 3) * (x + 3) - (x + 3));' \
+            'int a = 5;\nint b = a;\nint c = b;\nb = 9;\nprint(c);\nprint(b);\nprint(c + b);' \
+            'int a = 2; int b = 3; int c = 5; int d = 7;\nprint(((a + b) * (c - d)) / ((a - c) + (b * d)) - (a * (b + (c * (d + a)))));' \
+            'int z = 0;\nprint(1);\nprint(4 / z);\nprint(2);' \
+            'int i = 3;\nwhile (i) { print(10 / (i - 1)); i = i - 1; }\nprint(0);' \
+            'int z = 0; int i = 3; int s = 0;\nwhile (i) { if (z) { s = s + 10 / z; } i = i - 1; }\nprint(s);' \
+            'int m = 0 - 2147483647 - 1;\nint n = 0 - 1;\nprint(m / n);\nprint(m * n);\nprint(m / (n - 1));'; do
+    printf '%b\n' "$prog" > lv.src
+    "$mc" --run lv.src > o0.out 2>&1; rc0=$?
+    for O in -O1 -O2; do
+        "$mc" $O --run lv.src > on.out 2>&1; [ $? -eq $rc0 ] && cmp -s o0.out on.out || ok=0
+    done
+done
+printf 'int z = 0;\nprint(1);\nprint(4 / z);\n' > lv.src
+"$mc" -O2 --run lv.src > /dev/null 2>&1; [ $? -eq 1 ] || ok=0
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# -O2 hoists an invariant out of a nested loop (all the way out, over two rounds) and
+# out of a loop whose use of it sits in a branch; the result still runs the same.
+t=licm-nested-and-conditional
+ok=1
+for prog in 'int a = 3; int b = 4; int i = 3; int s = 0;\nif (s) { a = 5; b = 6; }\nwhile (i) {\n    int j = 2;\n    while (j) { s = s + a * b; j = j - 1; }\n    i = i - 1;\n}\nprint(s);' \
+            'int a = 3; int b = 4; int i = 4; int s = 0;\nif (s) { a = 5; b = 6; }\nwhile (i) {\n    if (i - 2) { s = s + a * b; } else { s = s - a * b; }\n    i = i - 1;\n}\nprint(s);'; do
+    printf '%b\n' "$prog" > licm.src
+    "$mc" -O2 licm.src > licm.tac || ok=0
+    # every a * b sits before the outer loop's test
+    awk '/ifz i goto/ { loop = 1 } / = a \* b$/ { n++; if (loop) bad = 1 } END { exit !(n && !bad) }' licm.tac || ok=0
+    "$mc" --run licm.src > o0.out 2>&1 && "$mc" -O2 --run licm.src > o2.out 2>&1 && cmp -s o0.out o2.out || ok=0
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --cache-dir: the first compile misses and stores an image, the second hits it, and a
+# damaged or truncated image is a miss that still compiles correctly.
+t=cache-hit-miss-corrupt
+ok=1
+"$mc" -O1 inc.src > cache.ref
+"$mc" -O1 --cache-dir cache inc.src > c.out 2> c.err && cmp -s cache.ref c.out && grep -q '^cache: 0 hits, 1 misses$' c.err || ok=0
+"$mc" -O1 --cache-dir cache inc.src > c.out 2> c.err && cmp -s cache.ref c.out && grep -q '^cache: 1 hits, 0 misses$' c.err || ok=0
+img=$(ls cache/*) && cp "$img" good.img || ok=0
+size=$(wc -c < good.img)
+for at in 20 $((size / 2)) $((size - 2)); do
+    cp good.img "$img"
+    printf '\377' | dd of="$img" bs=1 seek=$at conv=notrunc 2> /dev/null
+    "$mc" -O1 --cache-dir cache inc.src > c.out 2> c.err && cmp -s cache.ref c.out && grep -q '^cache: 0 hits, 1 misses$' c.err || ok=0
+done
+cp good.img "$img" && truncate -s $((size - 8)) "$img"
+"$mc" -O1 --cache-dir cache inc.src > c.out 2> c.err && cmp -s cache.ref c.out && grep -q '^cache: 0 hits, 1 misses$' c.err || ok=0
+"$mc" -O1 --cache-dir cache inc.src > c.out 2> c.err && cmp -s cache.ref c.out && grep -q '^cache: 1 hits, 0 misses$' c.err || ok=0
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --incremental after an edit that gives an if an else: only that statement is lowered
+# again, and the output matches a fresh --stream compile of the edited file.
+t=incremental-edit-adds-else
+ok=1
+printf 'int a = 1;\nint b = a + 2;\nif (a) print(1);\nwhile (b) { print(b); b = b - 1; }\nprint(a * 3);\n' > edit.src
+"$mc" -O1 --incremental edit.state edit.src > /dev/null 2> edit.err && grep -q 'incremental: 0 of 5 ' edit.err || ok=0
+printf 'int a = 1;\nint b = a + 2;\nif (a) print(1); else print(2);\nwhile (b) { print(b); b = b - 1; }\nprint(a * 3);\n' > edit.src
+"$mc" -O1 --stream edit.src > edit.ref
+"$mc" -O1 --incremental edit.state edit.src > edit.out 2> edit.err && grep -q 'incremental: 4 of 5 ' edit.err \
+   && cmp -s edit.ref edit.out || ok=0
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --pipeline only moves lexing and parsing onto their own threads: every backend's output
+# is byte for byte that of --stream.
+t=pipeline-matches-stream
+ok=1
+"$mc" --gen-src mixed 300 > mixed.src
+for O in -O0 -O1 -O2; do
+    for m in "" --asm --x86-64 --run; do
+        "$mc" $O $m --stream mixed.src > s.out 2>&1 && "$mc" $O $m --pipeline mixed.src > p.out 2>&1 \
+           && cmp -s s.out p.out || ok=0
+    done
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --batch writes for each input what compiling it on its own prints, whichever worker
+# took it; a bad input is reported by name without stopping the others.
+t=batch-matches-single
+ok=1
+"$mc" --gen-src loop 50 > loop.src && "$mc" --gen-src expr 50 > expr.src || ok=0
+printf 'int a = 1;\nint a = 2;\n' > dup.src
+mkdir -p out
+for m in "" --asm --x86-64; do
+    "$mc" -O1 $m --batch mixed.src loop.src dup.src expr.src edit.src --jobs 3 --out out 2> batch.err
+    [ $? -eq 1 ] && [ "$(cat batch.err)" = "dup.src: Error: Redeclaration: a" ] || ok=0
+    ext=$([ "$m" = --asm ] && echo asm || { [ "$m" = --x86-64 ] && echo s || echo tac; })
+    for f in mixed loop expr edit; do "$mc" -O1 $m $f.src | cmp -s - out/$f.$ext || ok=0; done
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --regs takes a count from 0 to 64 in digits and nothing else.
+t=regs-count-only
+ok=1
+"$mc" --asm --regs 8 inc.src > /dev/null 2>&1 && "$mc" --asm --regs 64 inc.src > /dev/null 2>&1 || ok=0
+for r in 65 -1 8x x '' ' 8' 99999999999999999999; do
+    "$mc" --asm --regs "$r" inc.src > /dev/null 2> regs.err; [ $? -eq 1 ] && grep -q 'must be 0..64' regs.err || ok=0
+done
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# --jobs reads its count like --parallel: `--jobs 2024.src` is an input, not a count.
+t=jobs-digit-filename
+ok=1
+rm -rf jobs && mkdir jobs
+"$mc" --batch inc.src --jobs 2024.src --out jobs > /dev/null 2>&1 && [ -f jobs/inc.tac ] && [ -f jobs/2024.tac ] || ok=0
+"$mc" --batch inc.src --jobs 2 2024.src --out jobs > /dev/null 2>&1 && "$mc" 2024.src | cmp -s - jobs/2024.tac || ok=0
+! "$mc" --batch inc.src --jobs -2 --out jobs > /dev/null 2>&1 || ok=0
+[ $ok -eq 1 ] && pass $t || fail $t
+
+# An input that cannot be read (a directory) is an error, not an empty program.
+t=unreadable-input
+ok=1
+mkdir -p dir.src
+for flags in "" --stream --pipeline; do
+    "$mc" $flags dir.src > /dev/null 2> dir.err; [ $? -eq 1 ] && grep -q '^Error: Cannot read dir.src$' dir.err || ok=0
+done
+"$mc" <(cat inc.src) > pipe.out && "$mc" inc.src | cmp -s - pipe.out || ok=0   # pipes still read through
+[ $ok -eq 1 ] && pass $t || fail $t
+
+exit $failed